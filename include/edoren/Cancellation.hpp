@@ -0,0 +1,284 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "Policy.hpp"
+#include "RefCounted.hpp"
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+namespace detail {
+
+// State shared by a CancellationSource and its tokens, the tokens don't depend on the Policy it was created with
+class CancellationState {
+public:
+    using Callback = UniqueFunction<void()>;
+
+    virtual ~CancellationState() = default;
+
+    // Owned through RefPtr, the count uses the atomics of the Policy
+    virtual void addReference() = 0;
+
+    virtual void releaseReference() = 0;
+
+    virtual bool isRequested() const = 0;
+
+    virtual bool canBeRequested() const = 0;
+
+    virtual void addSource() = 0;
+
+    virtual void releaseSource() = 0;
+
+    virtual bool request() = 0;
+
+    // Drops the subscribed callbacks without running them, and the ones subscribed afterwards. Does nothing once
+    // the cancellation was requested.
+    virtual void close() = 0;
+
+    // Returns 0 when the cancellation was already requested, the callback has run then, or when the state is
+    // closed, the callback is dropped then
+    virtual uint64_t subscribe(Callback callback) = 0;
+
+    // Returns whether the callback was removed before running. When it is running in another thread it waits for
+    // it to finish, so whatever the callback uses can be released right after.
+    virtual bool unsubscribe(uint64_t id) = 0;
+};
+
+// The callbacks run in the thread requesting the cancellation with the lock released, so they may subscribe or
+// unsubscribe themselves. The atomics and the lock come from `Policy`.
+template <typename Policy>
+class PolicyCancellationState final : public CancellationState, public RefCounted<Policy> {
+public:
+    void addReference() override {
+        RefCounted<Policy>::addReference();
+    }
+
+    void releaseReference() override {
+        RefCounted<Policy>::releaseReference();
+    }
+
+    bool isRequested() const override {
+        return m_requested.load(std::memory_order_acquire);
+    }
+
+    bool canBeRequested() const override {
+        return isRequested() || m_sources.load(std::memory_order_acquire) > 0;
+    }
+
+    void addSource() override {
+        m_sources.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void releaseSource() override {
+        m_sources.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    bool request() override {
+        std::unique_lock<Mutex> lock(m_mutex);
+        if (m_requested.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        m_requested.store(true, std::memory_order_release);
+        m_requester = std::this_thread::get_id();
+        while (!m_callbacks.empty()) {
+            auto it = m_callbacks.begin();
+            m_running = it->first;
+            Callback callback = std::move(it->second);
+            m_callbacks.erase(it);
+            lock.unlock();
+            callback();
+            lock.lock();
+            m_running = 0;
+            if constexpr (Policy::sIsThreadSafe) {
+                m_finished.notify_all();
+            }
+        }
+        return true;
+    }
+
+    void close() override {
+        std::map<uint64_t, Callback> callbacks;
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            if (m_requested.load(std::memory_order_relaxed)) {
+                // request() runs them all, this may be called from one of them
+                return;
+            }
+            m_closed = true;
+            // Destroyed outside the lock
+            callbacks.swap(m_callbacks);
+        }
+    }
+
+    uint64_t subscribe(Callback callback) override {
+        {
+            std::lock_guard<Mutex> lock(m_mutex);
+            if (m_closed) {
+                return 0;
+            }
+            if (!m_requested.load(std::memory_order_relaxed)) {
+                uint64_t id = ++m_lastId;
+                m_callbacks.emplace(id, std::move(callback));
+                return id;
+            }
+        }
+        callback();
+        return 0;
+    }
+
+    bool unsubscribe(uint64_t id) override {
+        Callback callback;
+        std::unique_lock<Mutex> lock(m_mutex);
+        auto it = m_callbacks.find(id);
+        if (it != m_callbacks.end()) {
+            // Destroyed outside the lock
+            callback = std::move(it->second);
+            m_callbacks.erase(it);
+            lock.unlock();
+            return true;
+        }
+        if constexpr (Policy::sIsThreadSafe) {
+            if (m_running == id && m_requester != std::this_thread::get_id()) {
+                m_finished.wait(lock, [this, id] { return m_running != id; });
+            }
+        }
+        return false;
+    }
+
+private:
+    using Mutex = typename Policy::Mutex;
+
+    // Only waited on when another thread can be running a callback
+    struct NoCondition {};
+
+    typename Policy::template Atomic<bool> m_requested{false};
+    typename Policy::template Atomic<uint32_t> m_sources{0};
+
+    Mutex m_mutex;
+    std::conditional_t<Policy::sIsThreadSafe, std::condition_variable, NoCondition> m_finished;
+    std::map<uint64_t, Callback> m_callbacks;
+    uint64_t m_lastId = 0;
+    uint64_t m_running = 0;
+    std::thread::id m_requester;
+    bool m_closed = false;
+};
+
+}  // namespace detail
+
+// Observes the cancellation requests of a CancellationSource, as std::stop_token does. A default constructed
+// token is never cancelled.
+class CancellationToken {
+public:
+    // Identifies a subscribed callback, it is safe to unsubscribe it after it ran
+    struct Registration {
+        uint64_t id = 0;
+    };
+
+    CancellationToken() = default;
+
+    bool isCancellationRequested() const {
+        return m_state && m_state->isRequested();
+    }
+
+    // Whether the cancellation was requested, or could still be
+    bool canBeCancelled() const {
+        return m_state && m_state->canBeRequested();
+    }
+
+    // Calls `func` once the cancellation is requested, or right away if it already was
+    template <typename Func>
+    Registration subscribe(Func&& func) const {
+        if (!m_state) {
+            return Registration();
+        }
+        return Registration{m_state->subscribe(detail::CancellationState::Callback(std::forward<Func>(func)))};
+    }
+
+    // Returns whether the callback was removed before running, waits for it when it is running in another thread
+    bool unsubscribe(Registration registration) const {
+        return m_state && registration.id != 0 && m_state->unsubscribe(registration.id);
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(detail::RefPtr<detail::CancellationState> state) : m_state(std::move(state)) {}
+
+    detail::RefPtr<detail::CancellationState> m_state;
+};
+
+// Requests the cancellation of the work holding its tokens, as std::stop_source does. Copies share the same
+// cancellation.
+class CancellationSource {
+public:
+    CancellationSource() : CancellationSource(MultiThreaded()) {}
+
+    // Synchronizes the cancellation as `Policy` does, with SingleThreaded the source and its tokens must only be
+    // used from a single thread
+    template <typename Policy, typename = decltype(Policy::sIsThreadSafe)>
+    explicit CancellationSource(Policy) : m_state(detail::makeRef<detail::PolicyCancellationState<Policy>>()) {
+        m_state->addSource();
+    }
+
+    CancellationSource(const CancellationSource& other) : m_state(other.m_state) {
+        m_state->addSource();
+    }
+
+    CancellationSource& operator=(const CancellationSource& other) = delete;
+
+    ~CancellationSource() {
+        m_state->releaseSource();
+    }
+
+    // Runs the subscribed callbacks in the calling thread, returns false if the cancellation was already requested
+    bool requestCancellation() {
+        return m_state->request();
+    }
+
+    bool isCancellationRequested() const {
+        return m_state->isRequested();
+    }
+
+    // Drops the subscribed callbacks without running them, and any callback subscribed afterwards. Meant for a
+    // source whose cancellation won't be requested anymore, so the callbacks stop holding what they captured.
+    void close() {
+        m_state->close();
+    }
+
+    CancellationToken getToken() const {
+        return CancellationToken(m_state);
+    }
+
+private:
+    detail::RefPtr<detail::CancellationState> m_state;
+};
+
+// Calls `func` once the cancellation of `token` is requested while it lives, as std::stop_callback does
+class CancellationCallback {
+public:
+    template <typename Func>
+    CancellationCallback(CancellationToken token, Func&& func)
+          : m_token(std::move(token)), m_registration(m_token.subscribe(std::forward<Func>(func))) {}
+
+    CancellationCallback(const CancellationCallback& other) = delete;
+
+    CancellationCallback& operator=(const CancellationCallback& other) = delete;
+
+    ~CancellationCallback() {
+        m_token.unsubscribe(m_registration);
+    }
+
+private:
+    CancellationToken m_token;
+    CancellationToken::Registration m_registration;
+};
+
+}  // namespace edoren
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+// An executor is any object with an `execute(Func&& func)` member function that runs `func()` at some point,
+// possibly in another thread. The functions given to it are move-only and take no arguments. Promise
+// continuations scheduled through an executor keep a reference to it, so it must outlive them.
+template <typename T, typename = void>
+struct IsExecutor : public std::false_type {};
+
+template <typename T>
+struct IsExecutor<T, std::void_t<decltype(std::declval<T&>().execute(std::declval<UniqueFunction<void()>>()))>>
+      : public std::true_type {};
+
+// Lanes of the executors that order their work by priority, see PriorityExecutor
+enum class Priority { HIGH, NORMAL, LOW };
+
+namespace detail {
+
+#if defined(__linux__)
+
+// Blocks the calling thread while `word` holds `expected`, until it is woken up or the `deadline` (if any)
+// expires. Spurious returns are possible, the caller must re-check its condition.
+template <typename T>
+void atomicWait(const std::atomic<T>& word, T expected, const std::chrono::steady_clock::time_point* deadline) {
+    static_assert(sizeof(std::atomic<T>) == sizeof(uint32_t), "futex words should be 32 bits wide");
+    struct timespec timeout = {};
+    if (deadline != nullptr) {
+        auto remaining = *deadline - std::chrono::steady_clock::now();
+        if (remaining <= std::chrono::steady_clock::duration::zero()) {
+            return;
+        }
+        auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+        timeout.tv_sec = static_cast<time_t>(seconds.count());
+        timeout.tv_nsec = static_cast<long>(std::chrono::nanoseconds(remaining - seconds).count());
+    }
+    syscall(SYS_futex,
+            reinterpret_cast<const uint32_t*>(&word),
+            FUTEX_WAIT_PRIVATE,
+            static_cast<uint32_t>(expected),
+            deadline != nullptr ? &timeout : nullptr,
+            nullptr,
+            0);
+}
+
+template <typename T>
+void atomicNotifyAll(const std::atomic<T>& word) {
+    syscall(SYS_futex, reinterpret_cast<const uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+// Portable fallback, the waiters park on a condition variable picked from a small table by address
+struct ParkingBucket {
+    std::mutex mutex;
+    std::condition_variable signaler;
+};
+
+inline ParkingBucket& getParkingBucket(const void* address) {
+    static ParkingBucket sBuckets[64];
+    return sBuckets[(reinterpret_cast<uintptr_t>(address) >> 4) % 64];
+}
+
+template <typename T>
+void atomicWait(const std::atomic<T>& word, T expected, const std::chrono::steady_clock::time_point* deadline) {
+    ParkingBucket& bucket = getParkingBucket(&word);
+    std::unique_lock<std::mutex> lock(bucket.mutex);
+    if (word.load(std::memory_order_seq_cst) == expected) {
+        if (deadline != nullptr) {
+            bucket.signaler.wait_until(lock, *deadline);
+        } else {
+            bucket.signaler.wait(lock);
+        }
+    }
+}
+
+template <typename T>
+void atomicNotifyAll(const std::atomic<T>& word) {
+    ParkingBucket& bucket = getParkingBucket(&word);
+    { std::lock_guard<std::mutex> lock(bucket.mutex); }
+    bucket.signaler.notify_all();
+}
+
+#endif
+
+// Per-thread queue that flattens nested inline work. Work runs right away while the nesting depth is below the
+// limit, past it the work is queued and the outermost frame runs it once the current work returns, so a long
+// chain of continuations fulfilling each other runs in a loop instead of recursing.
+class Trampoline {
+public:
+    static Trampoline& Current() {
+        thread_local Trampoline sTrampoline;
+        return sTrampoline;
+    }
+
+    template <typename Func>
+    void dispatch(Func&& func) {
+        if (isFull()) {
+            defer(std::forward<Func>(func));
+        } else {
+            run(std::forward<Func>(func));
+        }
+    }
+
+    // Whether new work would be queued instead of run
+    bool isFull() const {
+        return m_depth >= m_maxDepth;
+    }
+
+    template <typename Func>
+    void run(Func&& func) {
+        const bool outermost = m_depth == 0;
+        {
+            DepthGuard guard(m_depth);
+            std::forward<Func>(func)();
+        }
+        if (outermost) {
+            drain();
+        }
+    }
+
+    template <typename Func>
+    void defer(Func&& func) {
+        m_queue.emplace_back(std::forward<Func>(func));
+    }
+
+    // Runs the oldest queued function, returns false when there was none. Lets a thread waiting on a promise run
+    // the continuations queued below it.
+    bool runDeferred() {
+        if (m_queue.empty()) {
+            return false;
+        }
+        UniqueFunction<void()> func = std::move(m_queue.front());
+        m_queue.pop_front();
+        DepthGuard guard(m_depth);
+        func();
+        return true;
+    }
+
+    std::size_t getMaxDepth() const {
+        return m_maxDepth;
+    }
+
+    void setMaxDepth(std::size_t depth) {
+        m_maxDepth = depth;
+    }
+
+private:
+    struct DepthGuard {
+        explicit DepthGuard(std::size_t& depth) : depth(depth) {
+            depth++;
+        }
+
+        ~DepthGuard() {
+            depth--;
+        }
+
+        std::size_t& depth;
+    };
+
+    void drain() {
+        while (runDeferred()) {
+        }
+    }
+
+    std::size_t m_depth = 0;
+    std::size_t m_maxDepth = 64;
+    std::deque<UniqueFunction<void()>> m_queue;
+};
+
+// Lets the threads helping an executor from Promise::wait() park while it has nothing to run. They all park on
+// one word of the process, which is bumped when an executor they help gets new work or when a promise they wait
+// on is fulfilled. The executors only touch it while some helper of theirs is parked.
+class HelperParking {
+public:
+    // Registers a helper of this executor about to park, it should re-check for work before calling Park()
+    void enter() {
+        m_parked.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    void leave() {
+        m_parked.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Called by the executor once the new work can be taken
+    void notify() {
+        if (m_parked.load(std::memory_order_seq_cst) > 0) {
+            WakeAll();
+        }
+    }
+
+    // Read before the helper registers itself, a wake up after that point makes Park() return right away
+    static uint32_t Epoch() {
+        return Word().load(std::memory_order_seq_cst);
+    }
+
+    static void Park(uint32_t epoch, const std::chrono::steady_clock::time_point* deadline) {
+        atomicWait(Word(), epoch, deadline);
+    }
+
+    static void WakeAll() {
+        Word().fetch_add(1, std::memory_order_seq_cst);
+        atomicNotifyAll(Word());
+    }
+
+private:
+    static std::atomic<uint32_t>& Word() {
+        static std::atomic<uint32_t> sWord{0};
+        return sWord;
+    }
+
+    std::atomic<std::size_t> m_parked{0};
+};
+
+// Runs the pending work of an executor on behalf of a thread blocked in Promise::wait(), so waiting from inside
+// the executor keeps it moving instead of parking one of its threads. The executors with their own threads
+// install one in each of them.
+class WaitHelper {
+public:
+    virtual ~WaitHelper() = default;
+
+    // Runs one pending task, returns false when there was nothing to run
+    virtual bool runPendingTask() = 0;
+
+    // Where the thread can park once there is nothing to run, null when the executor can't wake it up
+    virtual HelperParking* getParking() {
+        return nullptr;
+    }
+
+    static WaitHelper*& Current() {
+        thread_local WaitHelper* sHelper = nullptr;
+        return sHelper;
+    }
+};
+
+template <typename T, typename = void>
+struct HasHelperParking : public std::false_type {};
+
+template <typename T>
+struct HasHelperParking<T, std::void_t<decltype(std::declval<T&>().getHelperParking())>> : public std::true_type {};
+
+// Helper for the executors with a runOnce() member function, and a getHelperParking() one when they can wake
+// up their parked helpers
+template <typename Executor>
+class RunOnceHelper final : public WaitHelper {
+public:
+    explicit RunOnceHelper(Executor& executor) : m_executor(executor) {}
+
+    bool runPendingTask() override {
+        return m_executor.runOnce();
+    }
+
+    HelperParking* getParking() override {
+        if constexpr (HasHelperParking<Executor>::value) {
+            return &m_executor.getHelperParking();
+        } else {
+            return nullptr;
+        }
+    }
+
+private:
+    Executor& m_executor;
+};
+
+// Installs `helper` in the calling thread for the lifetime of the scope
+class WaitHelperScope {
+public:
+    explicit WaitHelperScope(WaitHelper* helper) : m_previous(WaitHelper::Current()) {
+        WaitHelper::Current() = helper;
+    }
+
+    WaitHelperScope(const WaitHelperScope& other) = delete;
+
+    WaitHelperScope& operator=(const WaitHelperScope& other) = delete;
+
+    ~WaitHelperScope() {
+        WaitHelper::Current() = m_previous;
+    }
+
+private:
+    WaitHelper* m_previous;
+};
+
+}  // namespace detail
+
+// Runs the work right away in the calling thread, this is what continuations use when no executor is given
+class InlineExecutor {
+public:
+    template <typename Func>
+    void execute(Func&& func) {
+        std::forward<Func>(func)();
+    }
+};
+
+// Runs the work in the calling thread like InlineExecutor, but once the work nests deeper than the maximum depth
+// it is queued and run by the outermost call instead. The inline continuations of a promise are dispatched the
+// same way, the depth is shared by everything running in the thread.
+class TrampolineExecutor {
+public:
+    template <typename Func>
+    void execute(Func&& func) {
+        detail::Trampoline::Current().dispatch(std::forward<Func>(func));
+    }
+
+    static std::size_t GetMaxDepth() {
+        return detail::Trampoline::Current().getMaxDepth();
+    }
+
+    // Sets the nesting depth allowed in the calling thread before the work starts being queued
+    static void SetMaxDepth(std::size_t depth) {
+        detail::Trampoline::Current().setMaxDepth(depth);
+    }
+};
+
+}  // namespace edoren
@@ -0,0 +1,585 @@
+#pragma once
+
+#if defined(__linux__)
+
+    #include <fcntl.h>
+    #include <linux/io_uring.h>
+    #include <sys/eventfd.h>
+    #include <sys/mman.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+
+    #include <algorithm>
+    #include <cerrno>
+    #include <cstddef>
+    #include <cstdint>
+    #include <cstring>
+    #include <deque>
+    #include <memory>
+    #include <mutex>
+    #include <string>
+    #include <thread>
+    #include <utility>
+    #include <vector>
+
+    #include "Promise.hpp"
+    #include "ThreadPool.hpp"
+
+namespace edoren {
+
+namespace detail {
+
+// Minimal io_uring wrapper over the raw syscalls, only used from the thread that owns the ring
+class IoUring {
+public:
+    IoUring() = default;
+
+    IoUring(const IoUring& other) = delete;
+
+    IoUring& operator=(const IoUring& other) = delete;
+
+    ~IoUring() {
+        if (m_sqes != nullptr) {
+            ::munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing != nullptr && m_cqRing != m_sqRing) {
+            ::munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != nullptr) {
+            ::munmap(m_sqRing, m_sqRingSize);
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+        }
+    }
+
+    // Sets up the ring, returns false when io_uring or any of the `opcodes` is not available
+    bool init(unsigned entries, const std::vector<uint8_t>& opcodes) {
+        io_uring_params params = {};
+        m_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (m_fd < 0 || !supports(opcodes)) {
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMap) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = map(m_sqRingSize, IORING_OFF_SQ_RING);
+        if (m_sqRing == nullptr) {
+            return false;
+        }
+        m_cqRing = singleMap ? m_sqRing : map(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(map(m_sqesSize, IORING_OFF_SQES));
+        if (m_cqRing == nullptr || m_sqes == nullptr) {
+            return false;
+        }
+
+        auto* sq = static_cast<unsigned char*>(m_sqRing);
+        m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        m_sqEntries = params.sq_entries;
+        m_localTail = *m_sqTail;
+
+        auto* cq = static_cast<unsigned char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        m_cqEntries = params.cq_entries;
+        return true;
+    }
+
+    // Returns a cleared submission entry, or nullptr when the submission queue is full
+    io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_localTail - head >= m_sqEntries) {
+            return nullptr;
+        }
+        unsigned index = m_localTail & m_sqMask;
+        m_sqArray[index] = index;
+        io_uring_sqe* sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        m_localTail++;
+        return sqe;
+    }
+
+    // Submits every prepared entry and waits for at least `waitCount` completions, all in a single syscall
+    void submitAndWait(unsigned waitCount) {
+        __atomic_store_n(m_sqTail, m_localTail, __ATOMIC_RELEASE);
+        unsigned toSubmit = m_localTail - m_submitted;
+        unsigned flags = waitCount > 0 ? IORING_ENTER_GETEVENTS : 0;
+        long submitted = ::syscall(__NR_io_uring_enter, m_fd, toSubmit, waitCount, flags, nullptr, 0);
+        if (submitted > 0) {
+            m_submitted += static_cast<unsigned>(submitted);
+        }
+    }
+
+    template <typename Func>
+    void forEachCompletion(Func&& func) {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            io_uring_cqe cqe = m_cqes[head & m_cqMask];
+            head++;
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+            func(cqe);
+        }
+    }
+
+    unsigned getCompletionCapacity() const {
+        return m_cqEntries;
+    }
+
+private:
+    bool supports(const std::vector<uint8_t>& opcodes) const {
+        constexpr unsigned numOps = 256;
+        std::vector<unsigned char> storage(sizeof(io_uring_probe) + numOps * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(storage.data());
+        if (::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, numOps) < 0) {
+            return false;
+        }
+        return std::all_of(opcodes.begin(), opcodes.end(), [probe](uint8_t op) {
+            return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+        });
+    }
+
+    void* map(std::size_t size, off_t offset) const {
+        void* address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return address == MAP_FAILED ? nullptr : address;
+    }
+
+    int m_fd = -1;
+
+    void* m_sqRing = nullptr;
+    std::size_t m_sqRingSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned m_localTail = 0;
+    unsigned m_submitted = 0;
+
+    io_uring_sqe* m_sqes = nullptr;
+    std::size_t m_sqesSize = 0;
+
+    void* m_cqRing = nullptr;
+    std::size_t m_cqRingSize = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    unsigned m_cqEntries = 0;
+    io_uring_cqe* m_cqes = nullptr;
+};
+
+}  // namespace detail
+
+// Asynchronous file operations returning promises. The requests are handed to an io_uring owned by a single
+// thread: every request made while that thread is busy is submitted together with one io_uring_enter, which
+// also reaps the completions. When io_uring is not available the operations run as blocking calls on a thread
+// pool instead. The promises are fulfilled from the I/O thread (or the pool), continuations doing any real
+// work should be given an executor.
+class FileIO {
+public:
+    using Buffer = std::vector<char>;
+
+    enum class Backend { IO_URING, THREAD_POOL };
+
+    // The io_uring backend falls back to the thread pool when it is not available
+    explicit FileIO(Backend backend = Backend::IO_URING, unsigned entries = 256) {
+        if (backend == Backend::IO_URING) {
+            startRing(entries);
+        }
+        if (!m_ring) {
+            m_pool = std::make_unique<ThreadPool>(sPoolThreads);
+        }
+    }
+
+    FileIO(const FileIO& other) = delete;
+
+    FileIO& operator=(const FileIO& other) = delete;
+
+    // Waits for every operation already requested to complete
+    ~FileIO() {
+        if (m_ring) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            wakeUp();
+            m_thread.join();
+            ::close(m_wakeUp);
+        }
+    }
+
+    Backend getBackend() const {
+        return m_ring ? Backend::IO_URING : Backend::THREAD_POOL;
+    }
+
+    // Reads the whole file at `path`
+    Promise<Buffer> readFile(std::string path) {
+        return Promise<Buffer>([this, &path](auto&& resolve, auto&& reject) {
+            submit(std::make_unique<ReadFileOperation>(std::move(path), resolve, reject));
+        });
+    }
+
+    // Reads up to `size` bytes at `offset`, the buffer is shorter when the end of the file is reached
+    Promise<Buffer> pread(int fd, std::size_t size, off_t offset) {
+        return Promise<Buffer>([this, fd, size, offset](auto&& resolve, auto&& reject) {
+            submit(std::make_unique<ReadOperation>(fd, size, offset, resolve, reject));
+        });
+    }
+
+    // Writes `data` at `offset`, resolved with the number of bytes written
+    Promise<std::size_t> pwrite(int fd, Buffer data, off_t offset) {
+        return Promise<std::size_t>([this, fd, &data, offset](auto&& resolve, auto&& reject) {
+            submit(std::make_unique<WriteOperation>(fd, std::move(data), offset, resolve, reject));
+        });
+    }
+
+    Promise<void> fsync(int fd) {
+        return Promise<void>([this, fd](auto&& resolve, auto&& reject) {
+            submit(std::make_unique<SyncOperation>(fd, resolve, reject));
+        });
+    }
+
+private:
+    static constexpr std::size_t sPoolThreads = 4;
+    static constexpr std::size_t sReadChunkSize = 16 * 1024;
+
+    // A request, possibly made of several io_uring submissions (e.g. open, read and close)
+    struct Operation {
+        virtual ~Operation() = default;
+        virtual void prepare(io_uring_sqe& sqe) = 0;
+        // Handles the result of the last submission, returns whether another one is needed
+        virtual bool complete(int result) = 0;
+        // Blocking equivalent used by the thread pool backend
+        virtual void runBlocking() = 0;
+    };
+
+    template <typename T>
+    struct PromiseOperation : public Operation {
+        PromiseOperation(typename Promise<T>::ResolveCallback resolve, typename Promise<T>::RejectCallback reject)
+              : resolve(std::move(resolve)), reject(std::move(reject)) {}
+
+        void fail(int error) {
+            reject(std::string(std::strerror(error)));
+        }
+
+        typename Promise<T>::ResolveCallback resolve;
+        typename Promise<T>::RejectCallback reject;
+    };
+
+    struct ReadOperation : public PromiseOperation<Buffer> {
+        template <typename Resolve, typename Reject>
+        ReadOperation(int fd, std::size_t size, off_t offset, Resolve&& resolve, Reject&& reject)
+              : PromiseOperation<Buffer>(std::forward<Resolve>(resolve), std::forward<Reject>(reject)),
+                fd(fd),
+                offset(offset),
+                buffer(size) {}
+
+        void prepare(io_uring_sqe& sqe) override {
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<uintptr_t>(buffer.data());
+            sqe.len = static_cast<uint32_t>(buffer.size());
+            sqe.off = static_cast<uint64_t>(offset);
+        }
+
+        bool complete(int result) override {
+            if (result < 0) {
+                fail(-result);
+            } else {
+                buffer.resize(static_cast<std::size_t>(result));
+                resolve(std::move(buffer));
+            }
+            return false;
+        }
+
+        void runBlocking() override {
+            ssize_t result = ::pread(fd, buffer.data(), buffer.size(), offset);
+            complete(result < 0 ? -errno : static_cast<int>(result));
+        }
+
+        int fd;
+        off_t offset;
+        Buffer buffer;
+    };
+
+    struct WriteOperation : public PromiseOperation<std::size_t> {
+        template <typename Resolve, typename Reject>
+        WriteOperation(int fd, Buffer data, off_t offset, Resolve&& resolve, Reject&& reject)
+              : PromiseOperation<std::size_t>(std::forward<Resolve>(resolve), std::forward<Reject>(reject)),
+                fd(fd),
+                offset(offset),
+                data(std::move(data)) {}
+
+        void prepare(io_uring_sqe& sqe) override {
+            sqe.opcode = IORING_OP_WRITE;
+            sqe.fd = fd;
+            sqe.addr = reinterpret_cast<uintptr_t>(data.data());
+            sqe.len = static_cast<uint32_t>(data.size());
+            sqe.off = static_cast<uint64_t>(offset);
+        }
+
+        bool complete(int result) override {
+            if (result < 0) {
+                fail(-result);
+            } else {
+                resolve(static_cast<std::size_t>(result));
+            }
+            return false;
+        }
+
+        void runBlocking() override {
+            ssize_t result = ::pwrite(fd, data.data(), data.size(), offset);
+            complete(result < 0 ? -errno : static_cast<int>(result));
+        }
+
+        int fd;
+        off_t offset;
+        Buffer data;
+    };
+
+    struct SyncOperation : public PromiseOperation<void> {
+        template <typename Resolve, typename Reject>
+        SyncOperation(int fd, Resolve&& resolve, Reject&& reject)
+              : PromiseOperation<void>(std::forward<Resolve>(resolve), std::forward<Reject>(reject)), fd(fd) {}
+
+        void prepare(io_uring_sqe& sqe) override {
+            sqe.opcode = IORING_OP_FSYNC;
+            sqe.fd = fd;
+        }
+
+        bool complete(int result) override {
+            if (result < 0) {
+                fail(-result);
+            } else {
+                resolve();
+            }
+            return false;
+        }
+
+        void runBlocking() override {
+            complete(::fsync(fd) < 0 ? -errno : 0);
+        }
+
+        int fd;
+    };
+
+    // Opens the file, reads it in growing chunks until the end and closes it
+    struct ReadFileOperation : public PromiseOperation<Buffer> {
+        enum class Stage { OPEN, READ, CLOSE };
+
+        template <typename Resolve, typename Reject>
+        ReadFileOperation(std::string path, Resolve&& resolve, Reject&& reject)
+              : PromiseOperation<Buffer>(std::forward<Resolve>(resolve), std::forward<Reject>(reject)),
+                path(std::move(path)) {}
+
+        void prepare(io_uring_sqe& sqe) override {
+            switch (stage) {
+                case Stage::OPEN:
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.fd = AT_FDCWD;
+                    sqe.addr = reinterpret_cast<uintptr_t>(path.c_str());
+                    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                    break;
+                case Stage::READ:
+                    sqe.opcode = IORING_OP_READ;
+                    sqe.fd = fd;
+                    sqe.addr = reinterpret_cast<uintptr_t>(buffer.data() + size);
+                    sqe.len = static_cast<uint32_t>(buffer.size() - size);
+                    sqe.off = static_cast<uint64_t>(size);
+                    break;
+                case Stage::CLOSE:
+                    sqe.opcode = IORING_OP_CLOSE;
+                    sqe.fd = fd;
+                    break;
+            }
+        }
+
+        bool complete(int result) override {
+            switch (stage) {
+                case Stage::OPEN:
+                    if (result < 0) {
+                        fail(-result);
+                        return false;
+                    }
+                    fd = result;
+                    buffer.resize(sReadChunkSize);
+                    stage = Stage::READ;
+                    return true;
+                case Stage::READ:
+                    if (result < 0) {
+                        error = -result;
+                        stage = Stage::CLOSE;
+                    } else if (result == 0) {
+                        stage = Stage::CLOSE;
+                    } else {
+                        size += static_cast<std::size_t>(result);
+                        if (size == buffer.size()) {
+                            buffer.resize(buffer.size() * 2);
+                        }
+                    }
+                    return true;
+                case Stage::CLOSE:
+                    if (error != 0) {
+                        fail(error);
+                    } else {
+                        buffer.resize(size);
+                        resolve(std::move(buffer));
+                    }
+                    return false;
+            }
+            return false;
+        }
+
+        void runBlocking() override {
+            int result = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            bool pending = complete(result < 0 ? -errno : result);
+            while (pending) {
+                if (stage == Stage::READ) {
+                    ssize_t count = ::pread(fd, buffer.data() + size, buffer.size() - size, size);
+                    pending = complete(count < 0 ? -errno : static_cast<int>(count));
+                } else {
+                    pending = complete(::close(fd) < 0 ? -errno : 0);
+                }
+            }
+        }
+
+        std::string path;
+        Stage stage = Stage::OPEN;
+        int fd = -1;
+        int error = 0;
+        std::size_t size = 0;
+        Buffer buffer;
+    };
+
+    void startRing(unsigned entries) {
+        auto ring = std::make_unique<detail::IoUring>();
+        const std::vector<uint8_t> opcodes = {
+            IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_OPENAT, IORING_OP_CLOSE};
+        if (!ring->init(entries, opcodes)) {
+            return;
+        }
+        m_wakeUp = ::eventfd(0, EFD_CLOEXEC);
+        if (m_wakeUp < 0) {
+            return;
+        }
+        m_ring = std::move(ring);
+        m_thread = std::thread([this] { run(); });
+    }
+
+    void submit(std::unique_ptr<Operation> operation) {
+        if (!m_ring) {
+            m_pool->execute([operation = std::move(operation)] { operation->runBlocking(); });
+            return;
+        }
+        // Only the first request of a batch wakes up the I/O thread, the rest are picked up with it
+        bool first = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            first = m_requests.empty();
+            m_requests.push_back(operation.release());
+        }
+        if (first) {
+            wakeUp();
+        }
+    }
+
+    void wakeUp() {
+        uint64_t value = 1;
+        ssize_t written = ::write(m_wakeUp, &value, sizeof(value));
+        (void)written;
+    }
+
+    // The eventfd is read through the ring itself, a wake up arrives as one more completion
+    bool armWakeUp() {
+        io_uring_sqe* sqe = m_ring->getSqe();
+        if (sqe == nullptr) {
+            return false;
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_wakeUp;
+        sqe->addr = reinterpret_cast<uintptr_t>(&m_wakeUpValue);
+        sqe->len = sizeof(m_wakeUpValue);
+        sqe->user_data = 0;
+        return true;
+    }
+
+    void run() {
+        // The backlog holds the operations waiting for room in the ring, one submission entry is always kept
+        // for the eventfd read and the completions in flight are bounded by the completion queue size
+        std::deque<Operation*> backlog;
+        const unsigned capacity = m_ring->getCompletionCapacity() - 1;
+        unsigned inFlight = 0;
+        bool stopping = false;
+
+        bool wakeUpArmed = armWakeUp();
+        while (true) {
+            m_ring->submitAndWait(1);
+
+            bool wokenUp = false;
+            m_ring->forEachCompletion([&](const io_uring_cqe& cqe) {
+                if (cqe.user_data == 0) {
+                    wokenUp = true;
+                    return;
+                }
+                inFlight--;
+                auto* operation = reinterpret_cast<Operation*>(static_cast<uintptr_t>(cqe.user_data));
+                if (operation->complete(cqe.res)) {
+                    backlog.push_front(operation);
+                } else {
+                    delete operation;
+                }
+            });
+
+            if (wokenUp) {
+                wakeUpArmed = false;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                backlog.insert(backlog.end(), m_requests.begin(), m_requests.end());
+                m_requests.clear();
+                stopping = m_stopping;
+            }
+            if (stopping && backlog.empty() && inFlight == 0) {
+                return;
+            }
+            if (!wakeUpArmed) {
+                wakeUpArmed = armWakeUp();
+            }
+
+            while (!backlog.empty() && inFlight < capacity) {
+                io_uring_sqe* sqe = m_ring->getSqe();
+                if (sqe == nullptr) {
+                    break;
+                }
+                Operation* operation = backlog.front();
+                backlog.pop_front();
+                operation->prepare(*sqe);
+                sqe->user_data = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(operation));
+                inFlight++;
+            }
+        }
+    }
+
+    std::unique_ptr<detail::IoUring> m_ring;
+    int m_wakeUp = -1;
+    uint64_t m_wakeUpValue = 0;
+
+    std::mutex m_mutex;
+    std::vector<Operation*> m_requests;
+    bool m_stopping = false;
+
+    std::unique_ptr<ThreadPool> m_pool;
+    std::thread m_thread;
+};
+
+}  // namespace edoren
+
+#endif
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+namespace edoren {
+
+namespace detail {
+
+// Drop-in replacement of std::atomic for data only ever touched by one thread, the memory orders are ignored
+template <typename T>
+class NonAtomic {
+public:
+    constexpr NonAtomic() noexcept = default;
+
+    constexpr NonAtomic(T value) noexcept : m_value(value) {}
+
+    NonAtomic(const NonAtomic& other) = delete;
+
+    NonAtomic& operator=(const NonAtomic& other) = delete;
+
+    T load(std::memory_order = std::memory_order_seq_cst) const noexcept {
+        return m_value;
+    }
+
+    void store(T value, std::memory_order = std::memory_order_seq_cst) noexcept {
+        m_value = value;
+    }
+
+    T exchange(T value, std::memory_order = std::memory_order_seq_cst) noexcept {
+        T old = m_value;
+        m_value = value;
+        return old;
+    }
+
+    bool compare_exchange_strong(T& expected,
+                                 T desired,
+                                 std::memory_order = std::memory_order_seq_cst,
+                                 std::memory_order = std::memory_order_seq_cst) noexcept {
+        if (m_value == expected) {
+            m_value = desired;
+            return true;
+        }
+        expected = m_value;
+        return false;
+    }
+
+    bool compare_exchange_weak(T& expected,
+                               T desired,
+                               std::memory_order success = std::memory_order_seq_cst,
+                               std::memory_order failure = std::memory_order_seq_cst) noexcept {
+        return compare_exchange_strong(expected, desired, success, failure);
+    }
+
+    T fetch_add(T value, std::memory_order = std::memory_order_seq_cst) noexcept {
+        T old = m_value;
+        m_value += value;
+        return old;
+    }
+
+    T fetch_sub(T value, std::memory_order = std::memory_order_seq_cst) noexcept {
+        T old = m_value;
+        m_value -= value;
+        return old;
+    }
+
+private:
+    T m_value{};
+};
+
+// Drop-in replacement of std::mutex for data only ever touched by one thread, locking it does nothing
+class NullMutex {
+public:
+    void lock() noexcept {}
+
+    bool try_lock() noexcept {
+        return true;
+    }
+
+    void unlock() noexcept {}
+};
+
+}  // namespace detail
+
+// Synchronization policies of a Promise, given as its third template parameter
+
+// The default, a promise can be fulfilled, observed and waited on from any thread
+struct MultiThreaded {
+    template <typename T>
+    using Atomic = std::atomic<T>;
+
+    using Mutex = std::mutex;
+
+    static constexpr bool sIsThreadSafe = true;
+};
+
+// Every atomic operation and reference count is compiled down to a plain one, and every lock is removed. The
+// promise and everything chained to it must only be used from a single thread (e.g. with a RunLoop), wait() can't
+// block since no other thread could fulfill the promise.
+struct SingleThreaded {
+    template <typename T>
+    using Atomic = detail::NonAtomic<T>;
+
+    using Mutex = detail::NullMutex;
+
+    static constexpr bool sIsThreadSafe = false;
+};
+
+}  // namespace edoren
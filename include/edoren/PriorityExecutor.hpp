@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Executor.hpp"
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+// Executor with one queue per Priority lane. The work is taken from the most urgent lane first, but every lane
+// has a weight and once a lane used up its share of a round the next lanes are served, so a busy lane delays
+// the less urgent ones without ever starving them. The work runs in the executor's own threads, or in the
+// caller of run() / runOnce() when it has none.
+class PriorityExecutor {
+public:
+    using Task = UniqueFunction<void()>;
+
+    static constexpr std::size_t sNumLanes = 3;
+
+    // Dispatches to a single lane, so it can be given where a plain executor is expected
+    class Lane {
+    public:
+        template <typename Func>
+        void execute(Func&& func) {
+            m_owner->execute(std::forward<Func>(func), m_priority);
+        }
+
+    private:
+        friend class PriorityExecutor;
+
+        Lane(PriorityExecutor* owner, Priority priority) : m_owner(owner), m_priority(priority) {}
+
+        PriorityExecutor* m_owner;
+        Priority m_priority;
+    };
+
+    struct LaneStats {
+        // Tasks waiting in the lane right now, and the most there has ever been
+        std::size_t depth = 0;
+        std::size_t maxDepth = 0;
+        uint64_t executed = 0;
+    };
+
+    // Tasks taken from each lane per round while the more urgent ones are still busy
+    static constexpr std::array<unsigned, sNumLanes> sLaneWeights = {4, 2, 1};
+
+    explicit PriorityExecutor(std::size_t numThreads = 1)
+          : m_lanes{Lane(this, Priority::HIGH), Lane(this, Priority::NORMAL), Lane(this, Priority::LOW)},
+            m_credits(sLaneWeights) {
+        for (std::size_t i = 0; i < numThreads; i++) {
+            m_threads.emplace_back([this] { runWorker(); });
+        }
+    }
+
+    PriorityExecutor(const PriorityExecutor& other) = delete;
+
+    PriorityExecutor& operator=(const PriorityExecutor& other) = delete;
+
+    // Runs all the pending work before joining the threads
+    ~PriorityExecutor() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_signaler.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    template <typename Func>
+    void execute(Func&& func) {
+        execute(std::forward<Func>(func), Priority::NORMAL);
+    }
+
+    template <typename Func>
+    void execute(Func&& func, Priority priority) {
+        Task task(std::forward<Func>(func));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Queue& queue = m_queues[Index(priority)];
+            queue.tasks.push_back(std::move(task));
+            queue.stats.depth = queue.tasks.size();
+            queue.stats.maxDepth = std::max(queue.stats.maxDepth, queue.stats.depth);
+        }
+        m_signaler.notify_one();
+        m_parking.notify();
+    }
+
+    Lane& lane(Priority priority) {
+        return m_lanes[Index(priority)];
+    }
+
+    LaneStats getLaneStats(Priority priority) const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queues[Index(priority)].stats;
+    }
+
+    detail::HelperParking& getHelperParking() {
+        return m_parking;
+    }
+
+    // Runs the next task in the calling thread, returns false when there was nothing to run
+    bool runOnce() {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!pop(task)) {
+                return false;
+            }
+        }
+        task();
+        return true;
+    }
+
+    // Runs tasks in the calling thread until every lane is empty, returns how many ran
+    std::size_t run() {
+        std::size_t count = 0;
+        while (runOnce()) {
+            count++;
+        }
+        return count;
+    }
+
+private:
+    struct Queue {
+        std::deque<Task> tasks;
+        LaneStats stats;
+    };
+
+    static std::size_t Index(Priority priority) {
+        return static_cast<std::size_t>(priority);
+    }
+
+    // Takes the task of the most urgent lane that has credit left in this round, a new round starts once
+    // every busy lane spent its credit. Called with the mutex held.
+    bool pop(Task& task) {
+        for (int round = 0; round < 2; round++) {
+            for (std::size_t lane = 0; lane < sNumLanes; lane++) {
+                Queue& queue = m_queues[lane];
+                if (!queue.tasks.empty() && m_credits[lane] > 0) {
+                    m_credits[lane]--;
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                    queue.stats.depth = queue.tasks.size();
+                    queue.stats.executed++;
+                    return true;
+                }
+            }
+            m_credits = sLaneWeights;
+        }
+        return false;
+    }
+
+    void runWorker() {
+        detail::RunOnceHelper<PriorityExecutor> helper(*this);
+        detail::WaitHelperScope helperScope(&helper);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            Task task;
+            if (pop(task)) {
+                lock.unlock();
+                task();
+                lock.lock();
+            } else if (m_stopping) {
+                return;
+            } else {
+                m_signaler.wait(lock);
+            }
+        }
+    }
+
+    std::array<Lane, sNumLanes> m_lanes;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_signaler;
+    std::array<Queue, sNumLanes> m_queues;
+    std::array<unsigned, sNumLanes> m_credits;
+    bool m_stopping = false;
+    detail::HelperParking m_parking;
+
+    std::vector<std::thread> m_threads;
+};
+
+}  // namespace edoren
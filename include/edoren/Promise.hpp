@@ -1,291 +1,1799 @@
 #pragma once
 
-#include <condition_variable>
-#include <functional>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <utility>
+#include <variant>
 #include <vector>
 
+#include "Cancellation.hpp"
+#include "Executor.hpp"
+#include "Policy.hpp"
+#include "RefCounted.hpp"
+#include "TimerWheel.hpp"
+#include "UniqueFunction.hpp"
+
 namespace edoren {
 
-template <typename Res, typename Rej = std::string>
+namespace detail {
+
+// std::is_copy_constructible, except that it sees through std::vector, whose copy constructor is declared
+// even when its elements can't be copied
+template <typename T>
+struct IsCopyable : public std::is_copy_constructible<T> {};
+
+template <typename T, typename Allocator>
+struct IsCopyable<std::vector<T, Allocator>> : public IsCopyable<T> {};
+
+// Whether a ready result of type T is kept inside the promise handle, see Promise::m_ready
+template <typename T>
+struct IsInlineResult
+      : public std::bool_constant<std::is_trivially_copyable_v<T> && sizeof(T) <= 2 * sizeof(void*)> {};
+
+// Takes the place of the types not kept inline in the storage of a ready handle
+struct NotInline {};
+
+// Fixed number of slots written concurrently, each one by a single writer, and then taken all at once. The values
+// are written straight into the vector when they can be default constructed, except for bool since
+// std::vector<bool> packs its elements.
+template <typename T>
+class SlotVector {
+public:
+    explicit SlotVector(std::size_t size) : m_slots(size) {}
+
+    template <typename U>
+    void set(std::size_t index, U&& value) {
+        m_slots[index] = std::forward<U>(value);
+    }
+
+    std::vector<T> take() {
+        if constexpr (sInPlace) {
+            return std::move(m_slots);
+        } else {
+            std::vector<T> values;
+            values.reserve(m_slots.size());
+            for (auto& slot : m_slots) {
+                values.push_back(std::move(*slot));
+            }
+            return values;
+        }
+    }
+
+private:
+    static constexpr bool sInPlace = std::is_default_constructible_v<T> && !std::is_same_v<T, bool>;
+
+    std::conditional_t<sInPlace, std::vector<T>, std::vector<std::optional<T>>> m_slots;
+};
+
+// Notified once nothing wants the result of a demand tracked promise anymore
+template <typename Policy>
+class DemandListener : public RefCounted<Policy> {
+public:
+    virtual void abandoned() = 0;
+
+    // The promise was fulfilled, its result is no longer wanted from anywhere else
+    virtual void settled() {}
+};
+
+}  // namespace detail
+
+template <typename Res, typename Rej = std::string, typename Policy = MultiThreaded>
 class Promise;
 
+// Builds the reasons a promise is rejected with by the library itself. A reject type constructible from a
+// std::string_view gets a message, any other one needs a specialization providing Cancelled() to be used with
+// a CancellationToken. Moved() is value initialized unless specialized.
+template <typename Rej, typename = void>
+struct RejectReason {
+    static Rej Moved() {
+        return Rej();
+    }
+};
+
+template <typename Rej>
+struct RejectReason<Rej, std::enable_if_t<std::is_constructible_v<Rej, std::string_view>>> {
+    static Rej Cancelled() {
+        return Rej(std::string_view("Promise has been cancelled"));
+    }
+
+    static Rej Moved() {
+        return Rej(std::string_view("Promise has been moved"));
+    }
+};
+
+template <typename Rej, typename = void>
+struct HasCancellationReason : public std::false_type {};
+
+template <typename Rej>
+struct HasCancellationReason<Rej, std::void_t<decltype(RejectReason<Rej>::Cancelled())>> : public std::true_type {};
+
 template <typename T>
 struct IsPromise : public std::false_type {};
 
-template <typename Res, typename Rej>
-struct IsPromise<Promise<Res, Rej>> : public std::true_type {};
+template <typename Res, typename Rej, typename Policy>
+struct IsPromise<Promise<Res, Rej, Policy>> : public std::true_type {};
+
+namespace detail {
+
+// Wraps a continuation given along with a cancellation token, it is skipped when the token was cancelled by the
+// time it runs. A continuation returning a promise returns a promise rejected with the cancellation reason
+// instead, a void one returns without doing anything, its chained promise is rejected by withCancellation().
+template <typename Func>
+struct CancellableCallback {
+    template <typename... Args, typename = std::enable_if_t<std::is_invocable_v<Func&, Args...>>>
+    auto operator()(Args&&... args) -> std::invoke_result_t<Func&, Args...> {
+        using FuncRetType = std::invoke_result_t<Func&, Args...>;
+        if (token.isCancellationRequested()) {
+            if constexpr (IsPromise<FuncRetType>::value) {
+                return FuncRetType::Reject(FuncRetType::CancellationReason());
+            } else {
+                return;
+            }
+        }
+        return func(std::forward<Args>(args)...);
+    }
+
+    CancellationToken token;
+    Func func;
+};
+
+}  // namespace detail
 
-template <typename Res, typename Rej>
+template <typename Res, typename Rej, typename Policy>
 class Promise {
 public:
-    template <typename ResU, typename RejV>
+    template <typename ResU, typename RejV, typename PolicyW>
     friend class Promise;
 
     enum class Status { RESOLVED, REJECTED, ONGOING };
 
     using ResolveType = Res;
     using RejectType = Rej;
+    using PolicyType = Policy;
+
+    // Type of the stored value, a Promise<void> holds an empty one and its callbacks take no argument
+    using ValueType = std::conditional_t<std::is_void_v<ResolveType>, std::monostate, ResolveType>;
+
+    using ResolveCallback = std::conditional_t<std::is_void_v<ResolveType>,
+                                               UniqueFunction<void(void)>,
+                                               UniqueFunction<void(const ValueType& value)>>;
+    using RejectCallback = UniqueFunction<void(const RejectType& value)>;
+    using FinallyCallback = UniqueFunction<void(void)>;
 
-    using ResolveCallback = std::function<void(const ResolveType& value)>;
-    using RejectCallback = std::function<void(const RejectType& value)>;
-    using FinallyCallback = std::function<void(void)>;
+    // Outcome of one of the promises given to AllSettled(), `value` or `error` is set depending on the status
+    struct Settlement {
+        Status status = Status::ONGOING;
+        std::optional<ValueType> value;
+        std::optional<RejectType> error;
+    };
+
+    // Promise returned by Any(), rejected with the errors of all the promises
+    using AnyPromise = Promise<ResolveType, std::vector<RejectType>, Policy>;
+    using AllSettledPromise = Promise<std::vector<Settlement>, RejectType, Policy>;
 
 private:
+    // Storage for the result of a promise, it is accessed by index since ResolveType and RejectType can be the
+    // same type
+    using ResultType = std::variant<std::monostate, ValueType, RejectType>;
+
+    static constexpr std::size_t sValueIndex = 1;
+    static constexpr std::size_t sErrorIndex = 2;
+
+    static constexpr bool sIsValueInline = detail::IsInlineResult<ValueType>::value;
+    static constexpr bool sIsErrorInline = detail::IsInlineResult<RejectType>::value;
+
+    // Storage for the result of a ready handle, with the same indices as ResultType
+    using ReadyType = std::variant<std::monostate,
+                                   std::conditional_t<sIsValueInline, ValueType, detail::NotInline>,
+                                   std::conditional_t<sIsErrorInline, RejectType, detail::NotInline>>;
+
+    // How long a thread waiting while helping an executor blocks once there is nothing to run, when the executor
+    // can't wake it up for new work (see detail::HelperParking)
+    static constexpr std::chrono::microseconds sHelpInterval{200};
+
+    class SharedState;
+    using StatePtr = detail::RefPtr<SharedState>;
+
     class SharedState {
+        template <typename T>
+        using Atomic = typename Policy::template Atomic<T>;
+
+        // Internal status word. FULFILLING is held by the thread that won the race to fulfill the promise
+        // while it publishes the value, every other thread still observes the promise as ONGOING.
+        enum class State : uint32_t { ONGOING, FULFILLING, RESOLVED, REJECTED };
+
+        // Node of the intrusive continuation stack, the callbacks are pushed with a CAS and detached all at
+        // once by the thread that fulfills the promise. A continuation running as the `owner` of the result
+        // is its last reader and is allowed to move it out.
+        struct Continuation {
+            virtual ~Continuation() = default;
+            virtual void run(SharedState& state, bool owner) = 0;
+
+            Continuation* next = nullptr;
+        };
+
+        template <typename Func>
+        struct CallbackContinuation : public Continuation {
+            explicit CallbackContinuation(Func&& callback) : func(std::move(callback)) {}
+
+            void run(SharedState& state, bool owner) override {
+                func(state, owner);
+            }
+
+            Func func;
+        };
+
+        // Releases a continuation node, wherever it was allocated
+        struct ContinuationDeleter {
+            void operator()(Continuation* node) const {
+                state->destroyContinuation(node);
+            }
+
+            SharedState* state;
+        };
+
+        using ContinuationPtr = std::unique_ptr<Continuation, ContinuationDeleter>;
+
+        // Most promises have a single continuation, the first one that fits is stored in place
+        static constexpr std::size_t sInlineContinuationSize = 64;
+
     public:
-        void resolve(const ResolveType& value) {
-            std::lock_guard<std::mutex> lock(m_fulfilledMutex);
-            if (m_status == Promise::Status::ONGOING) {
-                m_status = Promise::Status::RESOLVED;
-                m_value = value;
-                for (auto& callback : m_resolveCallbacks) {
-                    callback(value);
+        SharedState() = default;
+
+        SharedState(const SharedState& other) = delete;
+
+        ~SharedState() {
+            Continuation* head = m_continuations.load(std::memory_order_acquire);
+            while (head != nullptr && head != Linked() && !IsClosed(head)) {
+                Continuation* next = head->next;
+                destroyContinuation(head);
+                head = next;
+            }
+        }
+
+        void addReference() {
+            m_references.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void releaseReference() {
+            if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete this;
+            }
+        }
+
+        // Adds a reference unless the state is already being destroyed
+        bool tryAddReference() {
+            uint32_t count = m_references.load(std::memory_order_relaxed);
+            while (count != 0) {
+                if (m_references.compare_exchange_weak(count, count + 1, std::memory_order_relaxed)) {
+                    return true;
                 }
-                for (auto& callback : m_finallyCallbacks) {
-                    callback();
+            }
+            return false;
+        }
+
+        template <typename T>
+        void resolve(T&& value) {
+            if (!acquire()) {
+                // ERROR: Promise already fulfilled
+                return;
+            }
+            if (isLinked()) {
+                m_forward->resolve(std::forward<T>(value));
+                m_state.store(State::RESOLVED, std::memory_order_release);
+                return;
+            }
+            m_result.template emplace<sValueIndex>(std::forward<T>(value));
+            publish(State::RESOLVED);
+        }
+
+        template <typename T>
+        void reject(T&& error) {
+            if (!acquire()) {
+                // ERROR: Promise already fulfilled
+                return;
+            }
+            if (isLinked()) {
+                m_forward->reject(std::forward<T>(error));
+                m_state.store(State::REJECTED, std::memory_order_release);
+                return;
+            }
+            m_result.template emplace<sErrorIndex>(std::forward<T>(error));
+            publish(State::REJECTED);
+        }
+
+        // Fulfills this state with the result of a fulfilled `other` state. The result is moved when `owner`
+        // is set, or when it can't be copied at all.
+        void settleFrom(SharedState& other, bool owner) {
+            settleFrom(other.m_result, owner);
+        }
+
+        void settleFrom(ResultType& result, bool owner) {
+            if (result.index() == sValueIndex) {
+                if constexpr (detail::IsCopyable<ValueType>::value) {
+                    if (!owner) {
+                        resolve(std::as_const(std::get<sValueIndex>(result)));
+                        return;
+                    }
                 }
-                m_resolveCallbacks.clear();
-                m_finallyCallbacks.clear();
-                m_signaler.notify_all();
+                resolve(std::move(std::get<sValueIndex>(result)));
             } else {
-                // ERROR: Promise already fulfilled
+                rejectFrom(std::get<sErrorIndex>(result), owner);
             }
         }
 
-        void reject(const RejectType& error) {
-            std::lock_guard<std::mutex> lock(m_fulfilledMutex);
-            if (m_status == Promise::Status::ONGOING) {
-                m_status = Promise::Status::REJECTED;
-                m_error = error;
-                for (auto& callback : m_rejectCallbacks) {
-                    callback(m_error);
+        void rejectFrom(RejectType& error, bool owner) {
+            if constexpr (detail::IsCopyable<RejectType>::value) {
+                if (!owner) {
+                    reject(std::as_const(error));
+                    return;
                 }
-                for (auto& callback : m_finallyCallbacks) {
-                    callback();
+            }
+            reject(std::move(error));
+        }
+
+        void addConsumer() {
+            m_consumers.fetch_add(1, std::memory_order_relaxed);
+            if (m_demandListener) {
+                addDemand();
+            }
+        }
+
+        void releaseConsumer() {
+            m_consumers.fetch_sub(1, std::memory_order_release);
+            if (m_demandListener) {
+                releaseDemand();
+            }
+        }
+
+        // Enables the demand tracking, it has to be called before the state is shared with other threads. The
+        // handles and the continuations of the state want its result, once the last one is gone while it is
+        // still ongoing the listener is notified and the state is rejected, releasing the continuations left.
+        void trackDemand(detail::RefPtr<detail::DemandListener<Policy>> listener) {
+            m_demandListener = std::move(listener);
+            m_demand.store(m_consumers.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+
+        bool tracksDemand() const {
+            return static_cast<bool>(m_demandListener);
+        }
+
+        void addDemand() {
+            m_demand.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Nothing can add demand once it reaches zero, handles and continuations come from existing handles
+        void releaseDemand() {
+            // Only the promises built with a CancellationToken track their demand, see Promise(Func&&)
+            if constexpr (HasCancellationReason<RejectType>::value) {
+                if (m_demand.fetch_sub(1, std::memory_order_acq_rel) == 1 &&
+                    getStatus() == Promise::Status::ONGOING) {
+                    m_demandListener->abandoned();
+                    reject(CancellationReason());
                 }
-                m_rejectCallbacks.clear();
-                m_finallyCallbacks.clear();
-                m_signaler.notify_all();
-            } else {
-                // ERROR: Promise already fulfilled
             }
         }
 
         Promise::Status getStatus() const {
-            return m_status;
+            switch (m_state.load(std::memory_order_acquire)) {
+                case State::RESOLVED:
+                    return Promise::Status::RESOLVED;
+                case State::REJECTED:
+                    return Promise::Status::REJECTED;
+                default:
+                    return Promise::Status::ONGOING;
+            }
+        }
+
+        ValueType& getValue() {
+            return std::get<sValueIndex>(m_result);
         }
 
-        const ResolveType& getValue() const {
-            return m_value;
+        RejectType& getError() {
+            return std::get<sErrorIndex>(m_result);
         }
 
-        const RejectType& getError() const {
-            return m_error;
+        ResultType& getResult() {
+            return m_result;
+        }
+
+        // Registers a single continuation that handles both outcomes, it receives this state once it is
+        // fulfilled and should check the status to know which one happened. The callable is stored directly
+        // in the continuation node, and the first node is placed in the inline slot when it fits.
+        // A caller that is about to drop the last handle to this state can `consume` it, so the callback can
+        // take the result if it runs right away.
+        template <typename Func>
+        void appendCallback(Func&& callback, bool consume = false) {
+            if (m_demandListener) {
+                // Released once the chained state is abandoned or settled, if any, see UpstreamDemand
+                addDemand();
+            }
+            Continuation* head = m_continuations.load(std::memory_order_acquire);
+            if (IsClosed(head)) {
+                callback(*this, consume && isExclusive(head));
+                return;
+            }
+
+            ContinuationPtr node(makeContinuation(std::forward<Func>(callback)), ContinuationDeleter{this});
+            do {
+                if (IsClosed(head)) {
+                    node->run(*this, consume && isExclusive(head));
+                    return;
+                }
+                node->next = head;
+            } while (!m_continuations.compare_exchange_weak(
+                head, node.get(), std::memory_order_release, std::memory_order_acquire));
+            node.release();
         }
 
-        std::mutex& getMutex() {
-            return m_fulfilledMutex;
+        // Waits until the promise is fulfilled or the `deadline` (if any) expires, returns the last status seen
+        Promise::Status wait(const std::chrono::steady_clock::time_point* deadline = nullptr) {
+            if constexpr (!Policy::sIsThreadSafe) {
+                // Nothing else could fulfill it while this thread is blocked
+                return getStatus();
+            }
+            while (true) {
+                State state = m_state.load(std::memory_order_acquire);
+                if (state == State::RESOLVED || state == State::REJECTED) {
+                    break;
+                }
+                if (deadline != nullptr && std::chrono::steady_clock::now() >= *deadline) {
+                    break;
+                }
+                // The waiter is registered before re-reading the status word, this pairs with the check done
+                // in publish() so either the waiter sees the new status or the publisher sees the waiter
+                m_waiters.fetch_add(1, std::memory_order_seq_cst);
+                state = m_state.load(std::memory_order_seq_cst);
+                if (state != State::RESOLVED && state != State::REJECTED) {
+                    if constexpr (Policy::sIsThreadSafe) {
+                        detail::atomicWait(m_state, state, deadline);
+                    }
+                }
+                m_waiters.fetch_sub(1, std::memory_order_relaxed);
+            }
+            return getStatus();
         }
 
-        void appendResolveCallback(ResolveCallback&& callback) {
-            m_resolveCallbacks.push_back(std::move(callback));
+        // Registers a thread about to park in detail::HelperParking while waiting on this state, returns whether
+        // the state is still ongoing. Pairs with the check done in publish() like wait() does.
+        bool addParkedHelper() {
+            m_parkedHelpers.fetch_add(1, std::memory_order_seq_cst);
+            State state = m_state.load(std::memory_order_seq_cst);
+            return state != State::RESOLVED && state != State::REJECTED;
         }
 
-        void appendRejectCallback(RejectCallback&& callback) {
-            m_rejectCallbacks.push_back(std::move(callback));
+        void releaseParkedHelper() {
+            m_parkedHelpers.fetch_sub(1, std::memory_order_relaxed);
         }
 
-        void appendFinallyCallback(FinallyCallback&& callback) {
-            m_finallyCallbacks.push_back(std::move(callback));
+        // Links this state to `target`, the result will be handed straight to it and never stored here. This
+        // is only possible while nothing observes this state: it has no continuations and its only handle is
+        // being consumed by the caller. When `target` is linked as well the link goes to its final target, so
+        // a chain of promises returning promises collapses into a single hop.
+        bool linkTo(StatePtr target) {
+            // A demand tracked state keeps the demand of its continuation instead
+            if (m_consumers.load(std::memory_order_acquire) != 1 || m_demandListener) {
+                return false;
+            }
+            while (target->isLinked()) {
+                target = target->m_forward;
+            }
+            m_forward = std::move(target);
+            Continuation* expected = nullptr;
+            if (m_continuations.compare_exchange_strong(
+                    expected, Linked(), std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return true;
+            }
+            m_forward.reset();
+            return false;
         }
 
-        void wait() {
-            if (m_status == Promise::Status::ONGOING) {
-                std::unique_lock<std::mutex> lock(m_signalMutex);
-                m_signaler.wait(lock);
+        // Whether the continuations of this fulfilled state are queued in the trampoline of the calling thread,
+        // a new one can still be appended behind them
+        bool hasPendingContinuations() const {
+            if (m_deferredOn.load(std::memory_order_relaxed) != &detail::Trampoline::Current()) {
+                return false;
             }
+            Continuation* head = m_continuations.load(std::memory_order_acquire);
+            return head != Linked() && !IsClosed(head);
         }
 
-    private:
-        Promise::Status m_status = Promise::Status::ONGOING;
-        ResolveType m_value;
-        RejectType m_error;
-        std::mutex m_fulfilledMutex;
+        // Whether the only handle left can take the result of this fulfilled state
+        bool isExclusive() const {
+            return isExclusive(m_continuations.load(std::memory_order_acquire));
+        }
 
-        std::condition_variable m_signaler;
-        std::mutex m_signalMutex;
+        // Readers are the continuations running or queued on an executor, the stack is only drained once the
+        // last of them is done with the result
+        void addReader() {
+            m_readers.fetch_add(1, std::memory_order_relaxed);
+        }
 
-        std::vector<ResolveCallback> m_resolveCallbacks;
-        std::vector<RejectCallback> m_rejectCallbacks;
-        std::vector<FinallyCallback> m_finallyCallbacks;
-    };
+        void releaseReader() {
+            if (m_readers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                m_continuations.store(Drained(), std::memory_order_release);
+            }
+        }
 
-public:
-    template <typename Func, typename = std::enable_if_t<!IsPromise<std::decay_t<Func>>::value>>
-    Promise(Func&& executor) {
-        // std::cout << "Creating 1" << std::endl;
-        m_shared = std::make_shared<SharedState>();
-        auto resolveFn = [shared = m_shared](const ResolveType& value) { shared->resolve(value); };
-        auto rejectFn = [shared = m_shared](const RejectType& reason) { shared->reject(reason); };
-        // static_assert(std::is_invocable<decltype(executor), decltype(resolveFn), decltype(rejectFn)>::value,
-        //               "Executor provider executor should accept a resolve and reject function, "
-        //               "please use: [](auto&& resolve, auto&& reject) {}");
-        executor(std::move(resolveFn), std::move(rejectFn));
-    }
+        // Whether the calling reader is the only one left and no handle can read the result anymore
+        bool isLastReader() const {
+            return m_readers.load(std::memory_order_acquire) == 1 && m_consumers.load(std::memory_order_acquire) == 0;
+        }
 
-    Promise(const Promise& other) = default;
+    private:
+        // Marks the continuation stack as closed, any callback pushed after this point runs immediately
+        static Continuation* Sealed() {
+            return reinterpret_cast<Continuation*>(alignof(Continuation));
+        }
 
-    Promise(Promise&& other) noexcept = default;
+        // Marks that the detached callbacks finished running, none of them reads the result anymore
+        static Continuation* Drained() {
+            return reinterpret_cast<Continuation*>(2 * alignof(Continuation));
+        }
 
-    static Promise Resolve(const ResolveType& value) {
-        // std::cout << "Resolve new" << std::endl;
-        auto newShared = std::make_shared<SharedState>();
-        newShared->resolve(value);
-        return Promise(newShared);
-    }
+        // Marks that this state forwards its result to another state, see linkTo()
+        static Continuation* Linked() {
+            return reinterpret_cast<Continuation*>(3 * alignof(Continuation));
+        }
 
-    static Promise Reject(const RejectType& reason) {
-        // std::cout << "Reject new" << std::endl;
-        auto newShared = std::make_shared<SharedState>();
-        newShared->reject(reason);
-        return Promise(newShared);
-    }
-
-    template <typename Func,
-              typename PromiseRetType =
-                  std::enable_if_t<(std::is_void_v<std::invoke_result_t<Func, const ResolveType&>> ||
-                                    IsPromise<std::invoke_result_t<Func, const ResolveType&>>::value),
-                                   std::conditional_t<std::is_void_v<std::invoke_result_t<Func, const ResolveType&>>,
-                                                      Promise,
-                                                      std::invoke_result_t<Func, const ResolveType&>>>>
-    auto then(Func&& func) const -> PromiseRetType {
-        using FuncRetType = std::invoke_result_t<Func, const ResolveType&>;
+        bool isLinked() const {
+            return m_continuations.load(std::memory_order_acquire) == Linked();
+        }
 
-        static_assert(IsPromise<PromiseRetType>::value, "Promise execution should return another promise or void");
-        static_assert(std::is_same_v<RejectType, typename PromiseRetType::RejectType>,
-                      "Promise RejectType should be the same");
+        static bool IsClosed(Continuation* head) {
+            return head == Sealed() || head == Drained();
+        }
 
-        if (!m_shared || m_shared->getStatus() == Promise::Status::REJECTED) {
-            if constexpr (std::is_void_v<FuncRetType>) {
-                return *this;
-            } else {
-                if constexpr (std::is_same_v<ResolveType, typename PromiseRetType::ResolveType>) {
-                    return *this;
-                } else {
-                    if (!m_shared) {
-                        // Error: Non-initialized promise
-                        if constexpr (std::is_constructible_v<RejectType, std::string_view>) {
-                            return PromiseRetType::Reject(RejectType("Non-initialized promise"));
-                        } else {
-                            return PromiseRetType::Reject(RejectType());
-                        }
-                    }
-                    return PromiseRetType::Reject(m_shared->getError());
+        bool isExclusive(Continuation* head) const {
+            return head == Drained() && m_readers.load(std::memory_order_acquire) == 0 &&
+                   m_consumers.load(std::memory_order_acquire) == 1;
+        }
+
+        template <typename Func>
+        Continuation* makeContinuation(Func&& callback) {
+            using Node = CallbackContinuation<std::decay_t<Func>>;
+            if constexpr (sizeof(Node) <= sInlineContinuationSize && alignof(Node) <= alignof(std::max_align_t)) {
+                if (!m_inlineContinuationUsed.exchange(true, std::memory_order_relaxed)) {
+                    return new (m_inlineContinuation) Node(std::forward<Func>(callback));
                 }
             }
+            return new Node(std::forward<Func>(callback));
         }
 
-        std::lock_guard<std::mutex> lock(m_shared->getMutex());
-
-        if (m_shared->getStatus() == Promise::Status::RESOLVED) {
-            if constexpr (std::is_void_v<FuncRetType>) {
-                func(m_shared->getValue());
-                return *this;
+        void destroyContinuation(Continuation* node) {
+            if (reinterpret_cast<unsigned char*>(node) == m_inlineContinuation) {
+                node->~Continuation();
             } else {
-                return func(m_shared->getValue());
+                delete node;
             }
-        } else if (m_shared->getStatus() == Promise::Status::ONGOING) {
-            if constexpr (std::is_void_v<FuncRetType>) {
-                // std::cout << "Ongoing (void) new" << std::endl;
-                auto newShared = std::make_shared<SharedState>();
-
-                m_shared->appendResolveCallback([func, newShared](auto& value) {
-                    func(value);
-                    newShared->resolve(value);  //
-                });
-                m_shared->appendRejectCallback([newShared](auto& error) {
-                    newShared->reject(error);  //
-                });
-
-                return Promise(newShared);
-            } else {
-                // std::cout << "Ongoing (Promise) new" << std::endl;
-                auto newShared = std::make_shared<typename PromiseRetType::SharedState>();
+        }
 
-                m_shared->appendResolveCallback([func, newShared](auto& value) {
-                    PromiseRetType other = func(value);
-                    other.then([newShared](auto& value) { newShared->resolve(value); });
-                    other.failed([newShared](auto& error) { newShared->reject(error); });
-                });
-                m_shared->appendRejectCallback([newShared](auto& error) {
-                    newShared->reject(error);  //
-                });
+        bool acquire() {
+            State expected = State::ONGOING;
+            return m_state.compare_exchange_strong(
+                expected, State::FULFILLING, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+
+        // Publishes the value, wakes the waiters and only then runs the detached callbacks. No state is held
+        // while user code runs, so a slow callback cannot delay other threads and a callback is free to
+        // register more continuations on this same promise.
+        void publish(State state) {
+            m_state.store(state, std::memory_order_seq_cst);
+            if constexpr (Policy::sIsThreadSafe) {
+                if (m_waiters.load(std::memory_order_seq_cst) != 0) {
+                    detail::atomicNotifyAll(m_state);
+                }
+                if (m_parkedHelpers.load(std::memory_order_seq_cst) != 0) {
+                    detail::HelperParking::WakeAll();
+                }
+            }
+            if (m_demandListener) {
+                m_demandListener->settled();
+            }
 
-                return PromiseRetType(newShared);
+            // Fulfilling the next promise of a chain publishes it from inside these callbacks, the trampoline
+            // bounds how deep that recursion goes
+            detail::Trampoline& trampoline = detail::Trampoline::Current();
+            if (trampoline.isFull()) {
+                m_deferredOn.store(&trampoline, std::memory_order_relaxed);
+                trampoline.defer([self = StatePtr(this)] { self->runContinuations(); });
+            } else {
+                trampoline.run([this] { runContinuations(); });
             }
         }
 
-        // ERROR: This should not happen as all the cases are covered
-        if constexpr (std::is_constructible_v<RejectType, std::string_view>) {
-            return PromiseRetType::Reject(RejectType("Non-initialized promise"));
-        } else {
-            return PromiseRetType::Reject(RejectType());
+        void runContinuations() {
+            // The link was set while the result was being stored
+            Continuation* ordered = detach();
+            if (ordered == Linked()) {
+                m_forward->settleFrom(*this, true);
+                m_continuations.store(Drained(), std::memory_order_release);
+                return;
+            }
+
+            // Once no Promise handle is left nobody else can read the result, so the last continuation can
+            // take it. Handles can't be created out of thin air, the count can only go down from here. The
+            // continuations deferred to an executor still read it later, they keep it from being taken.
+            addReader();
+            const bool unobserved = m_consumers.load(std::memory_order_acquire) == 0;
+            while (ordered != nullptr) {
+                ContinuationPtr current(ordered, ContinuationDeleter{this});
+                ordered = ordered->next;
+                const bool last = ordered == nullptr;
+                current->run(*this, unobserved && last && m_readers.load(std::memory_order_acquire) == 1);
+            }
+            releaseReader();
         }
-    }
 
-    template <typename Func>
-    auto failed(Func&& func) -> Promise& {
-        if (!m_shared) {
-            auto reason = RejectType();
-            if constexpr (std::is_constructible_v<RejectType, std::string_view>) {
-                reason = RejectType("Promise has been moved");
+        // Seals the stack and returns the detached callbacks in registration order
+        Continuation* detach() {
+            Continuation* head = m_continuations.exchange(Sealed(), std::memory_order_acq_rel);
+            if (head == Linked()) {
+                return head;
             }
-            func(reason);
-            return *this;
+            Continuation* ordered = nullptr;
+            while (head != nullptr) {
+                Continuation* next = head->next;
+                head->next = ordered;
+                ordered = head;
+                head = next;
+            }
+            return ordered;
+        }
+
+        Atomic<State> m_state{State::ONGOING};
+        // Only the alternative matching the final status is ever constructed
+        ResultType m_result;
+
+        Atomic<uint32_t> m_references{0};
+        Atomic<uint32_t> m_waiters{0};
+        Atomic<uint32_t> m_parkedHelpers{0};
+        // Number of Promise handles referencing this state
+        Atomic<uint32_t> m_consumers{0};
+        // Continuations running or pending on an executor, see addReader()
+        Atomic<uint32_t> m_readers{0};
+        // Handles and continuations wanting the result, only counted when a listener is set
+        Atomic<uint32_t> m_demand{0};
+        detail::RefPtr<detail::DemandListener<Policy>> m_demandListener;
+
+        Atomic<Continuation*> m_continuations{nullptr};
+        // Trampoline the continuations were queued in by publish(), if any
+        Atomic<const detail::Trampoline*> m_deferredOn{nullptr};
+        StatePtr m_forward;
+        Atomic<bool> m_inlineContinuationUsed{false};
+        alignas(std::max_align_t) unsigned char m_inlineContinuation[sInlineContinuationSize];
+    };
+
+    // Callables handed to the executor function to fulfill the promise
+    class Resolver {
+    public:
+        explicit Resolver(StatePtr shared) : m_shared(std::move(shared)) {}
+
+        void operator()(const ValueType& value) const {
+            m_shared->resolve(value);
         }
 
-        if (m_shared->getStatus() == Promise::Status::REJECTED) {
-            func(m_shared->getError());
-        } else if (m_shared->getStatus() == Promise::Status::ONGOING) {
-            m_shared->appendRejectCallback([func](auto& error) { func(error); });
+        void operator()(ValueType&& value) const {
+            m_shared->resolve(std::move(value));
         }
 
-        return *this;
-    }
+        template <typename T = ResolveType, typename = std::enable_if_t<std::is_void_v<T>>>
+        void operator()() const {
+            m_shared->resolve(ValueType());
+        }
+
+    private:
+        StatePtr m_shared;
+    };
+
+    class Rejecter {
+    public:
+        explicit Rejecter(StatePtr shared) : m_shared(std::move(shared)) {}
+
+        void operator()(const RejectType& reason) const {
+            m_shared->reject(reason);
+        }
+
+        void operator()(RejectType&& reason) const {
+            m_shared->reject(std::move(reason));
+        }
+
+    private:
+        StatePtr m_shared;
+    };
 
+    // The resolved value is given to the callbacks by const reference, unless they can only take it as an
+    // rvalue (e.g. a move-only type taken by value)
     template <typename Func>
-    auto finally(Func&& func) -> Promise& {
-        if (!m_shared) {
-            return *this;
+    using ValueArgType = std::conditional_t<std::is_invocable_v<Func, const ValueType&>, const ValueType&, ValueType&&>;
+
+    template <typename Func>
+    using CallbackResultType = typename std::conditional_t<std::is_void_v<ResolveType>,
+                                                           std::invoke_result<Func>,
+                                                           std::invoke_result<Func, ValueArgType<Func>>>::type;
+
+    // Passes the resolved value to `func`, it is moved when the caller owns the value and `func` accepts an
+    // rvalue. A `func` that only takes an rvalue gets a copy otherwise, unless the value is move-only: then it is
+    // moved regardless and the other readers of the result see it moved from.
+    template <typename Func>
+    static CallbackResultType<Func> InvokeWithValue(Func& func, ValueType& value, bool owner) {
+        if constexpr (std::is_void_v<ResolveType>) {
+            return func();
+        } else if constexpr (!std::is_invocable_v<Func&, const ValueType&>) {
+            if constexpr (detail::IsCopyable<ValueType>::value) {
+                if (!owner) {
+                    return func(ValueType(std::as_const(value)));
+                }
+            }
+            return func(std::move(value));
+        } else if constexpr (std::is_invocable_v<Func&, ValueType&&>) {
+            if (owner) {
+                return func(std::move(value));
+            }
+            return func(std::as_const(value));
+        } else {
+            return func(std::as_const(value));
         }
+    }
 
-        static_assert(std::is_void_v<std::invoke_result_t<Func>>, "Promise finally callback should return void");
+    template <typename Func, typename FuncRetType = CallbackResultType<Func>>
+    using ThenResultType =
+        std::enable_if_t<(std::is_void_v<FuncRetType> || IsPromise<FuncRetType>::value),
+                         std::conditional_t<std::is_void_v<FuncRetType>, Promise, FuncRetType>>;
 
-        if (m_shared->getStatus() != Promise::Status::ONGOING) {
-            func();
+public:
+    // An executor function taking a CancellationToken as a third argument makes the promise demand tracked: the
+    // token is cancelled once every handle to the promise, and to the promises chained after it with then(),
+    // via(), timeout() or withCancellation(), is gone while it is still ongoing. Any other continuation keeps
+    // the demand. The cancellation runs in the thread dropping the last handle, and the promise is rejected
+    // with CancellationReason().
+    template <typename Func, typename = std::enable_if_t<!IsPromise<std::decay_t<Func>>::value>>
+    Promise(Func&& executor) : Promise(detail::makeRef<SharedState>()) {
+        // static_assert(std::is_invocable<decltype(executor), Resolver, Rejecter>::value,
+        //               "Executor provider executor should accept a resolve and reject function, "
+        //               "please use: [](auto&& resolve, auto&& reject) {}");
+        if constexpr (std::is_invocable_v<Func&, Resolver, Rejecter, CancellationToken>) {
+            static_assert(HasCancellationReason<RejectType>::value,
+                          "A demand tracked promise is rejected with CancellationReason(), please specialize "
+                          "edoren::RejectReason with a Cancelled() function for the reject type");
+            auto listener = detail::makeRef<ProducerDemand>();
+            CancellationToken token = listener->source.getToken();
+            m_shared->trackDemand(std::move(listener));
+            executor(Resolver(m_shared), Rejecter(m_shared), std::move(token));
         } else {
-            m_shared->appendFinallyCallback([func]() { func(); });
+            executor(Resolver(m_shared), Rejecter(m_shared));
         }
+    }
 
-        return *this;
+    Promise(const Promise& other) : m_shared(other.m_shared), m_ready(other.m_ready) {
+        if (m_shared) {
+            m_shared->addConsumer();
+        }
+    }
+
+    Promise(Promise&& other) noexcept : m_shared(std::move(other.m_shared)), m_ready(other.m_ready) {
+        other.m_ready.template emplace<0>();
     }
 
-    void wait() {
+    ~Promise() {
         if (m_shared) {
-            m_shared->wait();
+            m_shared->releaseConsumer();
         }
     }
 
-private:
-    Promise(std::shared_ptr<SharedState> state) : m_shared(std::move(state)) {}
+    static Promise Resolve(const ValueType& value) {
+        return Fulfilled<sValueIndex>(value);
+    }
+
+    static Promise Resolve(ValueType&& value) {
+        return Fulfilled<sValueIndex>(std::move(value));
+    }
+
+    template <typename T = ResolveType, typename = std::enable_if_t<std::is_void_v<T>>>
+    static Promise Resolve() {
+        return Fulfilled<sValueIndex>();
+    }
+
+    static Promise Reject(const RejectType& reason) {
+        return Fulfilled<sErrorIndex>(reason);
+    }
+
+    static Promise Reject(RejectType&& reason) {
+        return Fulfilled<sErrorIndex>(std::move(reason));
+    }
+
+    // Returns a promise resolved once `duration` elapses. It is resolved from the timer thread, continuations
+    // doing any real work should be given an executor.
+    template <typename Rep, typename Period, typename T = ResolveType, typename = std::enable_if_t<std::is_void_v<T>>>
+    static Promise Delay(const std::chrono::duration<Rep, Period>& duration) {
+        return Delay(TimerWheel::Default(), duration);
+    }
+
+    template <typename Rep, typename Period, typename T = ResolveType, typename = std::enable_if_t<std::is_void_v<T>>>
+    static Promise Delay(TimerWheel& wheel, const std::chrono::duration<Rep, Period>& duration) {
+        static_assert(Policy::sIsThreadSafe, "Promise timers fire in another thread, the Policy should be thread-safe");
+        auto shared = detail::makeRef<SharedState>();
+        wheel.arm(duration, Resolver(shared));
+        return Promise(std::move(shared));
+    }
+
+    // Returns a promise resolved with the values of all the `promises` once every one of them is resolved, or
+    // rejected with the first error as soon as one of them is rejected. It is called on the promise of the
+    // tuple of values, e.g. Promise<std::tuple<User, Quota>>::All(fetchUser(), fetchQuota()), and a
+    // Promise<void> contributes an std::monostate. The values are collected in a single state shared by all
+    // the promises.
+    template <typename... Promises, typename = std::enable_if_t<(IsPromise<std::decay_t<Promises>>::value && ...)>>
+    static Promise All(Promises&&... promises) {
+        static_assert(std::is_same_v<ValueType, std::tuple<typename std::decay_t<Promises>::ValueType...>>,
+                      "Promise::All should resolve a std::tuple with the values of the promises");
+        static_assert((std::is_same_v<RejectType, typename std::decay_t<Promises>::RejectType> && ...),
+                      "Promise RejectType should be the same");
+        static_assert((std::is_same_v<Policy, typename std::decay_t<Promises>::PolicyType> && ...),
+                      "Promise Policy should be the same");
+
+        auto newShared = detail::makeRef<SharedState>();
+        if constexpr (sizeof...(Promises) == 0) {
+            newShared->resolve(ValueType());
+        } else {
+            auto state = detail::makeRef<TupleAllState<typename std::decay_t<Promises>::ValueType...>>(newShared);
+            AttachAll(state, std::index_sequence_for<Promises...>(), std::forward<Promises>(promises)...);
+        }
+        return Promise(std::move(newShared));
+    }
+
+    // Same as All(promises...) for the range of promises [first, last), called on the promise of the vector of
+    // values, e.g. Promise<std::vector<int>>::All(promises.begin(), promises.end()). Every promise writes its
+    // value in its own slot of a vector sized once. The promises are consumed when given move iterators.
+    template <typename Iterator, typename = std::enable_if_t<!IsPromise<std::decay_t<Iterator>>::value>>
+    static Promise All(Iterator first, Iterator last) {
+        using Child = std::decay_t<decltype(*first)>;
+        static_assert(IsPromise<Child>::value, "Promise::All should be given a range of promises");
+        static_assert(std::is_same_v<ValueType, std::vector<typename Child::ValueType>>,
+                      "Promise::All should resolve a std::vector with the values of the promises");
+        static_assert(std::is_same_v<RejectType, typename Child::RejectType>, "Promise RejectType should be the same");
+        static_assert(std::is_same_v<Policy, typename Child::PolicyType>, "Promise Policy should be the same");
+
+        auto newShared = detail::makeRef<SharedState>();
+        const auto count = static_cast<std::size_t>(std::distance(first, last));
+        if (count == 0) {
+            newShared->resolve(ValueType());
+            return Promise(std::move(newShared));
+        }
+
+        auto state = detail::makeRef<SlotsState<typename Child::ValueType, SharedState>>(newShared, count);
+        for (std::size_t index = 0; first != last; ++first, ++index) {
+            Child::Observe(*first, [state, index](auto& result, bool owner) {
+                if (result.index() == sErrorIndex) {
+                    state->result->rejectFrom(std::get<sErrorIndex>(result), owner);
+                    return;
+                }
+                state->slots.set(index, TakeValue(std::get<sValueIndex>(result), owner));
+                if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    state->result->resolve(state->slots.take());
+                }
+            });
+        }
+        return Promise(std::move(newShared));
+    }
+
+    // Returns a promise settled like the first of the `promises` to be fulfilled, resolved or rejected. The
+    // promises that lose the race stop referencing the result as soon as it is settled, and the ones left once a
+    // winner is known aren't observed at all. With no promises it never settles.
+    template <typename... Promises,
+              typename = std::enable_if_t<(std::is_same_v<std::decay_t<Promises>, Promise> && ...)>>
+    static Promise Race(Promises&&... promises) {
+        std::array<Promise, sizeof...(Promises)> list{{std::forward<Promises>(promises)...}};
+        return Race(std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+    }
+
+    template <typename Iterator, typename = std::enable_if_t<!IsPromise<std::decay_t<Iterator>>::value>>
+    static Promise Race(Iterator first, Iterator last) {
+        static_assert(std::is_same_v<std::decay_t<decltype(*first)>, Promise>,
+                      "Promise::Race should be given a range of promises of the same type");
+
+        auto newShared = detail::makeRef<SharedState>();
+        auto state = detail::makeRef<RaceState<SharedState>>(newShared);
+        for (; first != last && !state->isClaimed(); ++first) {
+            Observe(*first, [state](ResultType& result, bool owner) {
+                if (auto winner = state->claim()) {
+                    winner->settleFrom(result, owner);
+                }
+            });
+        }
+        return Promise(std::move(newShared));
+    }
+
+    // Returns a promise resolved with the value of the first of the `promises` to be resolved, or rejected with
+    // the errors of all of them, in order, when every one is rejected. The promises left behind are released as
+    // in Race().
+    template <typename... Promises,
+              typename = std::enable_if_t<(std::is_same_v<std::decay_t<Promises>, Promise> && ...)>>
+    static AnyPromise Any(Promises&&... promises) {
+        std::array<Promise, sizeof...(Promises)> list{{std::forward<Promises>(promises)...}};
+        return Any(std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+    }
+
+    template <typename Iterator, typename = std::enable_if_t<!IsPromise<std::decay_t<Iterator>>::value>>
+    static AnyPromise Any(Iterator first, Iterator last) {
+        static_assert(std::is_same_v<std::decay_t<decltype(*first)>, Promise>,
+                      "Promise::Any should be given a range of promises of the same type");
+
+        auto newShared = detail::makeRef<typename AnyPromise::SharedState>();
+        const auto count = static_cast<std::size_t>(std::distance(first, last));
+        if (count == 0) {
+            newShared->reject(std::vector<RejectType>());
+            return AnyPromise(std::move(newShared));
+        }
+
+        auto state = detail::makeRef<AnyState>(newShared, count);
+        for (std::size_t index = 0; first != last && !state->isClaimed(); ++first, ++index) {
+            Observe(*first, [state, index](ResultType& result, bool owner) {
+                if (result.index() == sValueIndex) {
+                    if (auto winner = state->claim()) {
+                        winner->resolve(TakeValue(std::get<sValueIndex>(result), owner));
+                    }
+                    return;
+                }
+                state->errors.set(index, TakeValue(std::get<sErrorIndex>(result), owner));
+                if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    if (auto winner = state->claim()) {
+                        winner->reject(state->errors.take());
+                    }
+                }
+            });
+        }
+        return AnyPromise(std::move(newShared));
+    }
+
+    // Returns a promise resolved once every one of the `promises` is fulfilled, with the outcome of each of them
+    // in order. It is never rejected.
+    template <typename... Promises,
+              typename = std::enable_if_t<(std::is_same_v<std::decay_t<Promises>, Promise> && ...)>>
+    static AllSettledPromise AllSettled(Promises&&... promises) {
+        std::array<Promise, sizeof...(Promises)> list{{std::forward<Promises>(promises)...}};
+        return AllSettled(std::make_move_iterator(list.begin()), std::make_move_iterator(list.end()));
+    }
+
+    template <typename Iterator, typename = std::enable_if_t<!IsPromise<std::decay_t<Iterator>>::value>>
+    static AllSettledPromise AllSettled(Iterator first, Iterator last) {
+        static_assert(std::is_same_v<std::decay_t<decltype(*first)>, Promise>,
+                      "Promise::AllSettled should be given a range of promises of the same type");
+        using SettledState = typename AllSettledPromise::SharedState;
+
+        auto newShared = detail::makeRef<SettledState>();
+        const auto count = static_cast<std::size_t>(std::distance(first, last));
+        if (count == 0) {
+            newShared->resolve(std::vector<Settlement>());
+            return AllSettledPromise(std::move(newShared));
+        }
+
+        auto state = detail::makeRef<SlotsState<Settlement, SettledState>>(newShared, count);
+        for (std::size_t index = 0; first != last; ++first, ++index) {
+            Observe(*first, [state, index](ResultType& result, bool owner) {
+                Settlement settlement;
+                if (result.index() == sValueIndex) {
+                    settlement.status = Status::RESOLVED;
+                    settlement.value.emplace(TakeValue(std::get<sValueIndex>(result), owner));
+                } else {
+                    settlement.status = Status::REJECTED;
+                    settlement.error.emplace(TakeValue(std::get<sErrorIndex>(result), owner));
+                }
+                state->slots.set(index, std::move(settlement));
+                if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    state->result->resolve(state->slots.take());
+                }
+            });
+        }
+        return AllSettledPromise(std::move(newShared));
+    }
+
+    template <typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Func&& func) const& -> PromiseRetType {
+        return Then(*this, std::forward<Func>(func), static_cast<InlineExecutor*>(nullptr));
+    }
+
+    // Chaining on a temporary consumes it, so its result can be moved into the callback when nothing else
+    // observes it
+    template <typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Func&& func) && -> PromiseRetType {
+        return Then(std::move(*this), std::forward<Func>(func), static_cast<InlineExecutor*>(nullptr));
+    }
+
+    // Same as then(func) but `func` is scheduled on `executor`, even when the promise is already fulfilled
+    template <typename Executor,
+              typename Func,
+              typename PromiseRetType = ThenResultType<Func>,
+              typename = std::enable_if_t<!std::is_same_v<std::remove_const_t<Executor>, CancellationToken>>>
+    auto then(Executor& executor, Func&& func) const& -> PromiseRetType {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return Then(*this, std::forward<Func>(func), &executor);
+    }
+
+    template <typename Executor,
+              typename Func,
+              typename PromiseRetType = ThenResultType<Func>,
+              typename = std::enable_if_t<!std::is_same_v<std::remove_const_t<Executor>, CancellationToken>>>
+    auto then(Executor& executor, Func&& func) && -> PromiseRetType {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return Then(std::move(*this), std::forward<Func>(func), &executor);
+    }
+
+    // Same as then(executor, func) but `func` is queued in the `priority` lane of `executor`, which should
+    // provide a lane(priority) executor like PriorityExecutor does
+    template <typename Executor, typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Executor& executor, Priority priority, Func&& func) const& -> PromiseRetType {
+        return then(executor.lane(priority), std::forward<Func>(func));
+    }
+
+    template <typename Executor, typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Executor& executor, Priority priority, Func&& func) && -> PromiseRetType {
+        return std::move(*this).then(executor.lane(priority), std::forward<Func>(func));
+    }
+
+    // Same as then(func), but once `token` is cancelled the returned promise is rejected with
+    // CancellationReason() and `func` is skipped if it has not run yet. Every continuation chained after it is
+    // skipped as well, as it is for any rejection. A token already cancelled rejects it right away, whatever the
+    // status of this promise.
+    template <typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(const CancellationToken& token, Func&& func) const& -> PromiseRetType {
+        return ThenCancellable(*this, token, std::forward<Func>(func), static_cast<InlineExecutor*>(nullptr));
+    }
+
+    template <typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(const CancellationToken& token, Func&& func) && -> PromiseRetType {
+        return ThenCancellable(
+            std::move(*this), token, std::forward<Func>(func), static_cast<InlineExecutor*>(nullptr));
+    }
+
+    // Same as then(token, func) with `func` scheduled on `executor`, it is skipped when the token is cancelled
+    // while it waits in the executor queue
+    template <typename Executor, typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Executor& executor, const CancellationToken& token, Func&& func) const& -> PromiseRetType {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return ThenCancellable(*this, token, std::forward<Func>(func), &executor);
+    }
+
+    template <typename Executor, typename Func, typename PromiseRetType = ThenResultType<Func>>
+    auto then(Executor& executor, const CancellationToken& token, Func&& func) && -> PromiseRetType {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return ThenCancellable(std::move(*this), token, std::forward<Func>(func), &executor);
+    }
+
+    // Returns a promise with the same outcome, or rejected with CancellationReason() as soon as `token` is
+    // cancelled while this one is still ongoing. It works the same on the promises returned by the combinators.
+    Promise withCancellation(const CancellationToken& token) const& {
+        return WithCancellation(*this, token);
+    }
+
+    Promise withCancellation(const CancellationToken& token) && {
+        return WithCancellation(std::move(*this), token);
+    }
+
+    // Reason the promises are rejected with when their cancellation token is cancelled
+    static RejectType CancellationReason() {
+        static_assert(HasCancellationReason<RejectType>::value,
+                      "The reject type can't be built from a std::string_view, please specialize "
+                      "edoren::RejectReason with a Cancelled() function to use it with a CancellationToken");
+        return RejectReason<RejectType>::Cancelled();
+    }
+
+    // Reason a moved-from promise is seen rejected with
+    static RejectType MovedReason() {
+        return RejectReason<RejectType>::Moved();
+    }
+
+    // Returns a promise fulfilled with the same outcome from `executor`, so every continuation attached to it
+    // runs there by default
+    template <typename Executor>
+    Promise via(Executor& executor) const& {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return Via(*this, executor);
+    }
+
+    template <typename Executor>
+    Promise via(Executor& executor) && {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        return Via(std::move(*this), executor);
+    }
+
+    template <typename Executor>
+    Promise via(Executor& executor, Priority priority) const& {
+        return via(executor.lane(priority));
+    }
+
+    template <typename Executor>
+    Promise via(Executor& executor, Priority priority) && {
+        return std::move(*this).via(executor.lane(priority));
+    }
+
+    // Returns a promise with the same outcome, or rejected with `reason` if this one is still ongoing after
+    // `duration`. The timer is cancelled as soon as this promise is fulfilled.
+    template <typename Rep, typename Period>
+    Promise timeout(const std::chrono::duration<Rep, Period>& duration, RejectType reason) const& {
+        return Timeout(*this, TimerWheel::Default(), duration, std::move(reason));
+    }
+
+    template <typename Rep, typename Period>
+    Promise timeout(const std::chrono::duration<Rep, Period>& duration, RejectType reason) && {
+        return Timeout(std::move(*this), TimerWheel::Default(), duration, std::move(reason));
+    }
+
+    template <typename Rep, typename Period>
+    Promise timeout(TimerWheel& wheel, const std::chrono::duration<Rep, Period>& duration, RejectType reason) const& {
+        return Timeout(*this, wheel, duration, std::move(reason));
+    }
+
+    template <typename Rep, typename Period>
+    Promise timeout(TimerWheel& wheel, const std::chrono::duration<Rep, Period>& duration, RejectType reason) && {
+        return Timeout(std::move(*this), wheel, duration, std::move(reason));
+    }
+
+    template <typename Func>
+    auto failed(Func&& func) -> Promise& {
+        if (!isValid()) {
+            func(MovedReason());
+            return *this;
+        }
+
+        const Promise::Status status = getContinuationStatus();
+        if (status == Promise::Status::REJECTED) {
+            func(getError());
+        } else if (status == Promise::Status::ONGOING) {
+            m_shared->appendCallback(MakeFailedCallback(std::forward<Func>(func)));
+        }
+
+        return *this;
+    }
+
+    template <typename Executor, typename Func>
+    auto failed(Executor& executor, Func&& func) -> Promise& {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        if (!isValid()) {
+            executor.execute([func = std::forward<Func>(func), reason = MovedReason()]() mutable { func(reason); });
+            return *this;
+        }
+
+        share();
+        m_shared->appendCallback(OnExecutor(&executor, MakeFailedCallback(std::forward<Func>(func))));
+        return *this;
+    }
+
+    template <typename Func>
+    auto finally(Func&& func) -> Promise& {
+        if (!isValid()) {
+            return *this;
+        }
+
+        static_assert(std::is_void_v<std::invoke_result_t<Func>>, "Promise finally callback should return void");
+
+        if (getContinuationStatus() != Promise::Status::ONGOING) {
+            func();
+        } else {
+            m_shared->appendCallback([func = std::forward<Func>(func)](SharedState&, bool) mutable { func(); });
+        }
+
+        return *this;
+    }
+
+    template <typename Executor, typename Func>
+    auto finally(Executor& executor, Func&& func) -> Promise& {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        static_assert(std::is_void_v<std::invoke_result_t<Func>>, "Promise finally callback should return void");
+        if (!isValid()) {
+            return *this;
+        }
+
+        share();
+        m_shared->appendCallback(
+            OnExecutor(&executor, [func = std::forward<Func>(func)](SharedState&, bool) mutable { func(); }));
+        return *this;
+    }
+
+    // Blocks until the promise is fulfilled. Called from a thread of an executor like ThreadPool, the thread runs
+    // the pending work of the executor meanwhile, so waiting on work queued behind the current task can't stall it.
+    void wait() const {
+        if (m_shared) {
+            help(detail::WaitHelper::Current(), nullptr);
+        }
+    }
+
+    // Same as wait() but the calling thread runs the pending work of `executor`, which should provide a runOnce()
+    // member function like RunLoop does
+    template <typename Executor>
+    void wait(Executor& executor) const {
+        if (m_shared) {
+            detail::RunOnceHelper<Executor> helper(executor);
+            help(&helper, nullptr);
+        }
+    }
+
+    template <typename Rep, typename Period>
+    Promise::Status waitFor(const std::chrono::duration<Rep, Period>& timeout) const {
+        return waitUntil(std::chrono::steady_clock::now() + timeout);
+    }
+
+    template <typename Clock, typename Duration>
+    Promise::Status waitUntil(const std::chrono::time_point<Clock, Duration>& deadline) const {
+        if (!m_shared) {
+            return getStatus();
+        }
+        auto steadyDeadline = std::chrono::steady_clock::now() +
+                              std::chrono::duration_cast<std::chrono::steady_clock::duration>(deadline - Clock::now());
+        return help(detail::WaitHelper::Current(), &steadyDeadline);
+    }
+
+private:
+    // Waits until the promise is fulfilled or the `deadline` (if any) expires, running the continuations queued
+    // in the trampoline of this thread and the work of `helper` (if any) in the meantime
+    Promise::Status help(detail::WaitHelper* helper, const std::chrono::steady_clock::time_point* deadline) const {
+        detail::Trampoline& trampoline = detail::Trampoline::Current();
+        while (true) {
+            const Promise::Status status = m_shared->getStatus();
+            if (status != Promise::Status::ONGOING ||
+                (deadline != nullptr && std::chrono::steady_clock::now() >= *deadline)) {
+                return status;
+            }
+            if (trampoline.runDeferred() || (helper != nullptr && helper->runPendingTask())) {
+                continue;
+            }
+            if (helper == nullptr) {
+                // Nothing else can be queued in the trampoline while this thread is blocked
+                return m_shared->wait(deadline);
+            }
+            if constexpr (!Policy::sIsThreadSafe) {
+                return status;
+            }
+            if (detail::HelperParking* parking = helper->getParking()) {
+                park(*parking, *helper, deadline);
+                continue;
+            }
+            auto interval = std::chrono::steady_clock::now() + sHelpInterval;
+            if (deadline != nullptr && *deadline <= interval) {
+                return m_shared->wait(deadline);
+            }
+            m_shared->wait(&interval);
+        }
+    }
+
+    // Parks the calling thread until the promise is fulfilled, the executor of `helper` gets new work or the
+    // `deadline` (if any) expires. Both are registered before the last check for work, so either the check
+    // sees the work or the status, or the waker sees the parked thread.
+    void park(detail::HelperParking& parking,
+              detail::WaitHelper& helper,
+              const std::chrono::steady_clock::time_point* deadline) const {
+        const uint32_t epoch = detail::HelperParking::Epoch();
+        parking.enter();
+        if (m_shared->addParkedHelper() && !helper.runPendingTask()) {
+            detail::HelperParking::Park(epoch, deadline);
+        }
+        m_shared->releaseParkedHelper();
+        parking.leave();
+    }
+
+    template <typename Self, typename Func, typename Executor>
+    static auto Then(Self&& self, Func&& func, Executor* executor) -> ThenResultType<Func> {
+        using FuncRetType = CallbackResultType<Func>;
+        using PromiseRetType = ThenResultType<Func>;
+        constexpr bool consume = !std::is_lvalue_reference_v<Self>;
+
+        static_assert(IsPromise<PromiseRetType>::value, "Promise execution should return another promise or void");
+        static_assert(std::is_same_v<RejectType, typename PromiseRetType::RejectType>,
+                      "Promise RejectType should be the same");
+        static_assert(std::is_same_v<Policy, typename PromiseRetType::PolicyType>,
+                      "Promise Policy should be the same");
+
+        // The status is read once, it can move from ONGOING to a fulfilled state at any point
+        const Promise::Status status = self.getContinuationStatus();
+
+        if (status == Promise::Status::REJECTED) {
+            if constexpr (std::is_void_v<FuncRetType>) {
+                return std::forward<Self>(self);
+            } else {
+                if constexpr (std::is_same_v<ResolveType, typename PromiseRetType::ResolveType>) {
+                    return std::forward<Self>(self);
+                } else {
+                    if (!self.isValid()) {
+                        // Error: Non-initialized promise
+                        if constexpr (std::is_constructible_v<RejectType, std::string_view>) {
+                            return PromiseRetType::Reject(RejectType("Non-initialized promise"));
+                        } else {
+                            return PromiseRetType::Reject(RejectType());
+                        }
+                    }
+                    return PromiseRetType::Reject(std::as_const(self.getError()));
+                }
+            }
+        }
+
+        if constexpr (std::is_same_v<Executor, InlineExecutor>) {
+            if (status == Promise::Status::RESOLVED) {
+                if constexpr (std::is_void_v<FuncRetType>) {
+                    InvokeWithValue(func, self.getValue(), false);
+                    return std::forward<Self>(self);
+                } else {
+                    return InvokeWithValue(func, self.getValue(), consume && self.ownsResult());
+                }
+            }
+        } else if (!self.m_shared) {
+            // Scheduling the callback needs a shared state to hold the result until it runs
+            return Then(self.toShared(), std::forward<Func>(func), executor);
+        }
+
+        // The promise is ONGOING, or the callback has to be scheduled on an executor
+        using NewSharedState = typename PromiseRetType::SharedState;
+        DemandGuard guard;
+        auto newShared = ChainedState<NewSharedState>(self.m_shared, guard);
+        auto callback = [func = std::forward<Func>(func), newShared, guard = std::move(guard)](SharedState& state,
+                                                                                             bool owner) mutable {
+            if constexpr (std::is_void_v<FuncRetType>) {
+                if (state.getStatus() == Promise::Status::RESOLVED) {
+                    // The value is still needed to resolve the chained promise, it can only be moved there
+                    InvokeWithValue(func, state.getValue(), false);
+                }
+                newShared->settleFrom(state, owner);
+            } else {
+                if (state.getStatus() == Promise::Status::RESOLVED) {
+                    PromiseRetType other = InvokeWithValue(func, state.getValue(), owner);
+                    std::move(other).forwardTo(newShared);
+                } else {
+                    newShared->rejectFrom(state.getError(), owner);
+                }
+            }
+        };
+        if constexpr (std::is_same_v<Executor, InlineExecutor>) {
+            self.m_shared->appendCallback(std::move(callback), consume);
+        } else {
+            self.m_shared->appendCallback(OnExecutor(executor, std::move(callback)), consume);
+        }
+
+        return PromiseRetType(std::move(newShared));
+    }
+
+    template <typename Self, typename Func, typename Executor>
+    static auto ThenCancellable(Self&& self, const CancellationToken& token, Func&& func, Executor* executor)
+        -> ThenResultType<Func> {
+        using PromiseRetType = ThenResultType<Func>;
+        if (token.isCancellationRequested()) {
+            return PromiseRetType::Reject(PromiseRetType::CancellationReason());
+        }
+        return Then(std::forward<Self>(self), MakeCancellable(token, std::forward<Func>(func)), executor)
+            .withCancellation(token);
+    }
+
+    template <typename Self, typename Executor>
+    static Promise Via(Self&& self, Executor& executor) {
+        constexpr bool consume = !std::is_lvalue_reference_v<Self>;
+        if (!self.isValid()) {
+            return std::forward<Self>(self);
+        }
+        if (!self.m_shared) {
+            return Via(self.toShared(), executor);
+        }
+
+        DemandGuard guard;
+        auto newShared = ChainedState<SharedState>(self.m_shared, guard);
+        self.m_shared->appendCallback(OnExecutor(&executor,
+                                                 [newShared, guard = std::move(guard)](SharedState& state, bool owner) {
+                                                     newShared->settleFrom(state, owner);
+                                                 }),
+                                      consume);
+        return Promise(std::move(newShared));
+    }
+
+    template <typename Self, typename Rep, typename Period>
+    static Promise Timeout(Self&& self,
+                           TimerWheel& wheel,
+                           const std::chrono::duration<Rep, Period>& duration,
+                           RejectType reason) {
+        static_assert(Policy::sIsThreadSafe, "Promise timers fire in another thread, the Policy should be thread-safe");
+        constexpr bool consume = !std::is_lvalue_reference_v<Self>;
+        if (self.getStatus() != Promise::Status::ONGOING) {
+            return std::forward<Self>(self);
+        }
+
+        // Whichever comes first fulfills the new promise, the other one finds it already fulfilled
+        DemandGuard guard;
+        auto newShared = ChainedState<SharedState>(self.m_shared, guard);
+        TimerWheel::TimerId timer = wheel.arm(
+            duration, [newShared, reason = std::move(reason)]() mutable { newShared->reject(std::move(reason)); });
+        self.m_shared->appendCallback(
+            [newShared, &wheel, timer, guard = std::move(guard)](SharedState& state, bool owner) {
+                wheel.cancel(timer);
+                newShared->settleFrom(state, owner);
+            },
+            consume);
+        return Promise(std::move(newShared));
+    }
+
+    template <typename Self>
+    static Promise WithCancellation(Self&& self, const CancellationToken& token) {
+        constexpr bool consume = !std::is_lvalue_reference_v<Self>;
+        if (self.getStatus() != Promise::Status::ONGOING || !token.canBeCancelled()) {
+            return std::forward<Self>(self);
+        }
+
+        // Same as Timeout(), whichever comes first fulfills the new promise
+        DemandGuard guard;
+        auto newShared = ChainedState<SharedState>(self.m_shared, guard);
+        CancellationToken::Registration registration =
+            token.subscribe([newShared] { newShared->reject(CancellationReason()); });
+        self.m_shared->appendCallback(
+            [newShared, token, registration, guard = std::move(guard)](SharedState& state, bool owner) {
+                token.unsubscribe(registration);
+                newShared->settleFrom(state, owner);
+            },
+            consume);
+        return Promise(std::move(newShared));
+    }
+
+    // Listener of a demand tracked producer, its executor function holds a token of `source`. The callbacks the
+    // producer subscribed usually hold its Resolver or Rejecter, they are dropped once the promise is settled so
+    // they don't keep the state alive through this listener.
+    struct ProducerDemand : public detail::DemandListener<Policy> {
+        void abandoned() override {
+            source.requestCancellation();
+        }
+
+        void settled() override {
+            source.close();
+        }
+
+        CancellationSource source{Policy()};
+    };
+
+    // Listener of a state chained after a demand tracked one, it gives back the demand of its continuation
+    // once, when the chained state is abandoned or settled. The upstream state isn't owned: it owns the
+    // continuation, which owns the chained state and this listener. It is detached by the continuation as it
+    // is destroyed, see DemandGuard.
+    class UpstreamDemand : public detail::DemandListener<Policy> {
+    public:
+        explicit UpstreamDemand(SharedState* upstream) : m_upstream(upstream) {}
+
+        void abandoned() override {
+            release();
+        }
+
+        void settled() override {
+            release();
+        }
+
+        void detach() {
+            std::lock_guard<Mutex> lock(m_mutex);
+            m_upstream = nullptr;
+        }
+
+    private:
+        void release() {
+            SharedState* upstream = nullptr;
+            {
+                std::lock_guard<Mutex> lock(m_mutex);
+                if (m_upstream != nullptr && m_upstream->tryAddReference()) {
+                    upstream = m_upstream;
+                }
+                m_upstream = nullptr;
+            }
+            if (upstream != nullptr) {
+                upstream->releaseDemand();
+                upstream->releaseReference();
+            }
+        }
+
+        using Mutex = typename Policy::Mutex;
+
+        Mutex m_mutex;
+        SharedState* m_upstream;
+    };
+
+    // Held by the continuation that settles a chained state, detaches its UpstreamDemand once it is destroyed
+    class DemandGuard {
+    public:
+        DemandGuard() = default;
+
+        DemandGuard(DemandGuard&& other) noexcept = default;
+
+        ~DemandGuard() {
+            if (m_demand) {
+                m_demand->detach();
+            }
+        }
+
+    private:
+        friend class Promise;
+
+        detail::RefPtr<UpstreamDemand> m_demand;
+    };
+
+    // New state for the promise chained after `upstream` by one of its continuations, demand tracked when
+    // `upstream` is. The continuation should hold `guard` until it is destroyed.
+    template <typename NewSharedState>
+    static detail::RefPtr<NewSharedState> ChainedState(const StatePtr& upstream, DemandGuard& guard) {
+        auto newShared = detail::makeRef<NewSharedState>();
+        if (upstream->tracksDemand()) {
+            auto listener = detail::makeRef<UpstreamDemand>(upstream.get());
+            guard.m_demand = listener;
+            newShared->trackDemand(std::move(listener));
+        }
+        return newShared;
+    }
+
+    template <typename Func>
+    static detail::CancellableCallback<std::decay_t<Func>> MakeCancellable(const CancellationToken& token,
+                                                                           Func&& func) {
+        return detail::CancellableCallback<std::decay_t<Func>>{token, std::forward<Func>(func)};
+    }
+
+    // Shared by the promises given to All(), each slot is written once by the continuation of its promise and
+    // the last one to arrive moves them into the result
+    template <typename... Values>
+    struct TupleAllState : public detail::RefCounted<Policy> {
+        explicit TupleAllState(StatePtr result) : result(std::move(result)) {}
+
+        StatePtr result;
+        std::tuple<std::optional<Values>...> slots;
+        typename Policy::template Atomic<std::size_t> pending{sizeof...(Values)};
+    };
+
+    // Shared by the range of promises given to All() or AllSettled(), each promise writes its own slot and the
+    // last one to arrive hands them to the result
+    template <typename T, typename Result>
+    struct SlotsState : public detail::RefCounted<Policy> {
+        SlotsState(detail::RefPtr<Result> result, std::size_t count)
+              : result(std::move(result)), slots(count), pending(count) {}
+
+        detail::RefPtr<Result> result;
+        detail::SlotVector<T> slots;
+        typename Policy::template Atomic<std::size_t> pending;
+    };
+
+    // Shared by the promises given to Race() or Any(). The first one to claim it settles the result and lets it
+    // go right away, so the promises that lose the race only keep this small state alive.
+    template <typename Result>
+    struct RaceState : public detail::RefCounted<Policy> {
+        explicit RaceState(detail::RefPtr<Result> result) : result(std::move(result)) {}
+
+        // Returns the result to the winner only
+        detail::RefPtr<Result> claim() {
+            if (claimed.exchange(true, std::memory_order_acq_rel)) {
+                return nullptr;
+            }
+            return std::move(result);
+        }
+
+        bool isClaimed() const {
+            return claimed.load(std::memory_order_acquire);
+        }
+
+        detail::RefPtr<Result> result;
+        typename Policy::template Atomic<bool> claimed{false};
+    };
+
+    struct AnyState : public RaceState<typename AnyPromise::SharedState> {
+        AnyState(detail::RefPtr<typename AnyPromise::SharedState> result, std::size_t count)
+              : RaceState<typename AnyPromise::SharedState>(std::move(result)), errors(count), pending(count) {}
+
+        detail::SlotVector<RejectType> errors;
+        typename Policy::template Atomic<std::size_t> pending;
+    };
+
+    template <typename State, std::size_t... Indices, typename... Promises>
+    static void AttachAll(const detail::RefPtr<State>& state, std::index_sequence<Indices...>, Promises&&... promises) {
+        (AttachAllSlot<Indices>(state, std::forward<Promises>(promises)), ...);
+    }
+
+    template <std::size_t Index, typename State, typename Child>
+    static void AttachAllSlot(const detail::RefPtr<State>& state, Child&& child) {
+        std::decay_t<Child>::Observe(std::forward<Child>(child), [state](auto& result, bool owner) {
+            if (result.index() == sErrorIndex) {
+                state->result->rejectFrom(std::get<sErrorIndex>(result), owner);
+                return;
+            }
+            std::get<Index>(state->slots).emplace(TakeValue(std::get<sValueIndex>(result), owner));
+            if (state->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                // Ignored when an error got there first
+                state->result->resolve(
+                    std::apply([](auto&... slots) { return ValueType(std::move(*slots)...); }, state->slots));
+            }
+        });
+    }
+
+    // Copies the value, unless the caller owns it or it can't be copied
+    template <typename T>
+    static T TakeValue(T& value, bool owner) {
+        if constexpr (detail::IsCopyable<T>::value) {
+            if (!owner) {
+                return value;
+            }
+        }
+        return std::move(value);
+    }
+
+    // Calls `func(result, owner)` with the result of `self` once it is fulfilled, the result may be moved from
+    // when `owner` is set. A moved-from promise is seen as rejected.
+    template <typename Self, typename Func>
+    static void Observe(Self&& self, Func&& func) {
+        constexpr bool consume = !std::is_lvalue_reference_v<Self>;
+        if (self.m_shared) {
+            self.m_shared->appendCallback(
+                [func = std::forward<Func>(func)](SharedState& state, bool owner) mutable {
+                    func(state.getResult(), owner);
+                },
+                consume);
+        } else {
+            ResultType result = self.getReadyResult();
+            func(result, true);
+        }
+    }
+
+    template <typename Func>
+    static auto MakeFailedCallback(Func&& func) {
+        return [func = std::forward<Func>(func)](SharedState& state, bool) mutable {
+            if (state.getStatus() == Promise::Status::REJECTED) {
+                func(state.getError());
+            }
+        };
+    }
+
+    // Continuation callback queued on an executor. The callback is declared last so it is destroyed before the
+    // state it may still point to, see DemandGuard.
+    template <typename Callback>
+    struct ExecutorTask {
+        void operator()() {
+            callback(*shared, owner || shared->isLastReader());
+            shared->releaseReader();
+        }
+
+        StatePtr shared;
+        bool owner;
+        Callback callback;
+    };
+
+    // Wraps a continuation callback so it runs on `executor`, the state is kept alive until it does. It stays a
+    // reader of the state meanwhile, so nothing else takes the result before it runs.
+    template <typename Executor, typename Callback>
+    static auto OnExecutor(Executor* executor, Callback&& callback) {
+        return [executor, callback = std::forward<Callback>(callback)](SharedState& state, bool owner) mutable {
+            state.addReader();
+            executor->execute(ExecutorTask<std::decay_t<Callback>>{StatePtr(&state), owner, std::move(callback)});
+        };
+    }
+
+    // Copies the inline result of a ready handle into a new shared state
+    Promise toShared() const {
+        ResultType result = getReadyResult();
+        auto newShared = detail::makeRef<SharedState>();
+        newShared->settleFrom(result, true);
+        return Promise(std::move(newShared));
+    }
+
+    // Moves the inline result of a ready handle into a shared state, in place
+    void share() {
+        if (!m_shared) {
+            ResultType result = getReadyResult();
+            m_shared = detail::makeRef<SharedState>();
+            m_shared->settleFrom(result, true);
+            m_shared->addConsumer();
+            m_ready.template emplace<0>();
+        }
+    }
+
+    // Settles `target` with the outcome of this promise once it is fulfilled, the handle is consumed. When
+    // nothing else observes this promise its state is linked to `target` instead, as in JS promise assimilation.
+    void forwardTo(const StatePtr& target) && {
+        if (m_shared) {
+            if (!m_shared->linkTo(target)) {
+                m_shared->appendCallback(
+                    [target](SharedState& state, bool owner) { target->settleFrom(state, owner); }, true);
+            }
+        } else {
+            ResultType result = getReadyResult();
+            target->settleFrom(result, true);
+        }
+    }
+
+    // Result of a ready handle, a moved-from one is seen as rejected
+    ResultType getReadyResult() const {
+        if constexpr (sIsValueInline) {
+            if (m_ready.index() == sValueIndex) {
+                return ResultType(std::in_place_index<sValueIndex>, std::get<sValueIndex>(m_ready));
+            }
+        }
+        if constexpr (sIsErrorInline) {
+            if (m_ready.index() == sErrorIndex) {
+                return ResultType(std::in_place_index<sErrorIndex>, std::get<sErrorIndex>(m_ready));
+            }
+        }
+        return ResultType(std::in_place_index<sErrorIndex>, MovedReason());
+    }
+
+    bool isValid() const {
+        return m_shared || m_ready.index() != 0;
+    }
+
+    // A non initialized promise behaves as a rejected one
+    Promise::Status getStatus() const {
+        if (m_shared) {
+            return m_shared->getStatus();
+        }
+        return m_ready.index() == sValueIndex ? Promise::Status::RESOLVED : Promise::Status::REJECTED;
+    }
+
+    // Status seen by a new inline continuation. The continuations of a promise fulfilled past the trampoline depth
+    // are queued (see SharedState::publish()), until they run the thread that queued them sees the promise as
+    // ongoing so a new one is appended behind them instead of running first.
+    Promise::Status getContinuationStatus() const {
+        const Promise::Status status = getStatus();
+        if (status != Promise::Status::ONGOING && m_shared && m_shared->hasPendingContinuations()) {
+            return Promise::Status::ONGOING;
+        }
+        return status;
+    }
+
+    ValueType& getValue() const {
+        if constexpr (sIsValueInline) {
+            return m_shared ? m_shared->getValue() : std::get<sValueIndex>(m_ready);
+        } else {
+            return m_shared->getValue();
+        }
+    }
+
+    RejectType& getError() const {
+        if constexpr (sIsErrorInline) {
+            return m_shared ? m_shared->getError() : std::get<sErrorIndex>(m_ready);
+        } else {
+            return m_shared->getError();
+        }
+    }
+
+    // Whether this handle is the only reader left of an already fulfilled result
+    bool ownsResult() const {
+        return !m_shared || m_shared->isExclusive();
+    }
+
+    Promise(StatePtr state) : m_shared(std::move(state)) {
+        if (m_shared) {
+            m_shared->addConsumer();
+        }
+    }
+
+    template <std::size_t Index, typename... Args>
+    Promise(std::in_place_index_t<Index> index, Args&&... args) : m_ready(index, std::forward<Args>(args)...) {}
+
+    // Creates a promise already fulfilled with the result at `Index`, see m_ready
+    template <std::size_t Index, typename... Args>
+    static Promise Fulfilled(Args&&... args) {
+        if constexpr (Index == sValueIndex ? sIsValueInline : sIsErrorInline) {
+            return Promise(std::in_place_index<Index>, std::forward<Args>(args)...);
+        } else {
+            auto newShared = detail::makeRef<SharedState>();
+            if constexpr (Index == sValueIndex) {
+                newShared->resolve(std::forward<Args>(args)...);
+            } else {
+                newShared->reject(std::forward<Args>(args)...);
+            }
+            return Promise(std::move(newShared));
+        }
+    }
 
-    std::shared_ptr<SharedState> m_shared;
+    // Set for a ready handle once its result has to be shared, see share()
+    StatePtr m_shared;
+    // Result of a promise created already fulfilled, it stays in the handle since no SharedState is needed
+    // until something has to wait on it. Only results trivially copyable and up to two words are kept here (see
+    // detail::IsInlineResult): they spare Resolve() and Reject() an allocation and copy as cheaply as the
+    // pointer, but sizeof(Promise) grows with the largest of them. Any other result is held by a SharedState
+    // from the start, a handle copied then takes a reference instead of copying or allocating.
+    mutable ReadyType m_ready;
 };
 
 }  // namespace edoren
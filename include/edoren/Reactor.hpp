@@ -0,0 +1,284 @@
+#pragma once
+
+#if defined(__linux__)
+
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <unistd.h>
+
+    #include <algorithm>
+    #include <cerrno>
+    #include <cstdint>
+    #include <cstring>
+    #include <iterator>
+    #include <mutex>
+    #include <string>
+    #include <system_error>
+    #include <thread>
+    #include <unordered_map>
+    #include <utility>
+    #include <vector>
+
+    #include "Promise.hpp"
+
+namespace edoren {
+
+// File descriptor readiness as promises, backed by epoll and serviced by a single thread. Every wait is a
+// one-shot registration, so thousands of pending reads and writes cost one thread and a small entry each.
+// The promises are resolved through the executor given on construction, or in the reactor thread when none is.
+// The reactor is an executor too, the work given to execute() runs in its thread.
+class Reactor {
+public:
+    using Task = UniqueFunction<void()>;
+
+    Reactor() {
+        start();
+    }
+
+    template <typename Executor>
+    explicit Reactor(Executor& executor)
+          : m_dispatch([&executor](Task&& task) { executor.execute(std::move(task)); }) {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+        start();
+    }
+
+    Reactor(const Reactor& other) = delete;
+
+    Reactor& operator=(const Reactor& other) = delete;
+
+    // The promises still waiting are rejected
+    ~Reactor() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        wakeUp();
+        m_thread.join();
+
+        for (auto& entry : m_registrations) {
+            rejectAll(entry.second.readers, "Reactor has been destroyed");
+            rejectAll(entry.second.writers, "Reactor has been destroyed");
+        }
+        ::close(m_wakeUp);
+        ::close(m_epoll);
+    }
+
+    // Resolved once `fd` can be read without blocking, or has reached the end of the stream or an error
+    Promise<void> readable(int fd) {
+        return wait(fd, EPOLLIN);
+    }
+
+    // Resolved once `fd` can be written without blocking, or has an error
+    Promise<void> writable(int fd) {
+        return wait(fd, EPOLLOUT);
+    }
+
+    // Rejects the promises waiting on `fd`, it should be called before closing a descriptor with pending waits
+    void cancel(int fd) {
+        Registration registration;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_registrations.find(fd);
+            if (it == m_registrations.end()) {
+                return;
+            }
+            registration = std::move(it->second);
+            m_registrations.erase(it);
+            ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        rejectAll(registration.readers, "Reactor wait cancelled");
+        rejectAll(registration.writers, "Reactor wait cancelled");
+    }
+
+    template <typename Func>
+    void execute(Func&& func) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back(std::forward<Func>(func));
+        }
+        wakeUp();
+    }
+
+private:
+    struct Waiter {
+        Promise<void>::ResolveCallback resolve;
+        Promise<void>::RejectCallback reject;
+    };
+
+    struct Registration {
+        std::vector<Waiter> readers;
+        std::vector<Waiter> writers;
+    };
+
+    static constexpr int sMaxEvents = 64;
+
+    void start() {
+        m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        if (m_epoll < 0) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        }
+        m_wakeUp = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (m_wakeUp < 0) {
+            int error = errno;
+            ::close(m_epoll);
+            throw std::system_error(error, std::generic_category(), "eventfd");
+        }
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = m_wakeUp;
+        ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeUp, &event);
+
+        m_thread = std::thread([this] { run(); });
+    }
+
+    void wakeUp() {
+        uint64_t value = 1;
+        ssize_t written = ::write(m_wakeUp, &value, sizeof(value));
+        (void)written;
+    }
+
+    Promise<void> wait(int fd, uint32_t events) {
+        return Promise<void>([this, fd, events](auto&& resolve, auto&& reject) {
+            int error = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                Registration& registration = m_registrations[fd];
+                std::vector<Waiter>& waiters = events == EPOLLIN ? registration.readers : registration.writers;
+                waiters.push_back(Waiter{resolve, reject});
+                if (!arm(fd, registration)) {
+                    error = errno;
+                    waiters.pop_back();
+                    if (registration.readers.empty() && registration.writers.empty()) {
+                        m_registrations.erase(fd);
+                    }
+                }
+            }
+            if (error != 0) {
+                reject(std::string(std::strerror(error)));
+            }
+        });
+    }
+
+    // Registers the interest of the pending waiters of `fd`, called with the mutex held. The registrations are
+    // one-shot, once an event is reported the descriptor stays disabled until it is armed again.
+    bool arm(int fd, const Registration& registration) {
+        epoll_event event = {};
+        event.events = EPOLLONESHOT;
+        event.events |= registration.readers.empty() ? 0 : static_cast<uint32_t>(EPOLLIN);
+        event.events |= registration.writers.empty() ? 0 : static_cast<uint32_t>(EPOLLOUT);
+        event.data.fd = fd;
+        if (::epoll_ctl(m_epoll, EPOLL_CTL_MOD, fd, &event) == 0) {
+            return true;
+        }
+        return errno == ENOENT && ::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    void run() {
+        epoll_event events[sMaxEvents];
+        std::vector<Waiter> ready;
+        while (true) {
+            int count = ::epoll_wait(m_epoll, events, sMaxEvents, -1);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+
+            bool wokenUp = false;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (int i = 0; i < count; i++) {
+                    if (events[i].data.fd == m_wakeUp) {
+                        wokenUp = true;
+                    } else {
+                        collect(events[i], ready);
+                    }
+                }
+            }
+
+            for (Waiter& waiter : ready) {
+                dispatch(std::move(waiter.resolve));
+            }
+            ready.clear();
+
+            if (wokenUp) {
+                uint64_t value = 0;
+                ssize_t bytesRead = ::read(m_wakeUp, &value, sizeof(value));
+                (void)bytesRead;
+                if (runTasks()) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Moves the waiters satisfied by `event` to `ready` and arms the descriptor again for the others, called
+    // with the mutex held. Errors and hang-ups wake up both sides, the next read or write reports them.
+    void collect(const epoll_event& event, std::vector<Waiter>& ready) {
+        auto it = m_registrations.find(event.data.fd);
+        if (it == m_registrations.end()) {
+            return;
+        }
+        Registration& registration = it->second;
+        const uint32_t failed = EPOLLERR | EPOLLHUP;
+        if ((event.events & (EPOLLIN | EPOLLRDHUP | failed)) != 0) {
+            std::move(registration.readers.begin(), registration.readers.end(), std::back_inserter(ready));
+            registration.readers.clear();
+        }
+        if ((event.events & (EPOLLOUT | failed)) != 0) {
+            std::move(registration.writers.begin(), registration.writers.end(), std::back_inserter(ready));
+            registration.writers.clear();
+        }
+        if (registration.readers.empty() && registration.writers.empty()) {
+            m_registrations.erase(it);
+        } else {
+            arm(event.data.fd, registration);
+        }
+    }
+
+    // Runs the work queued with execute(), returns whether the reactor is stopping
+    bool runTasks() {
+        std::vector<Task> tasks;
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            tasks.swap(m_tasks);
+            stopping = m_stopping;
+        }
+        for (Task& task : tasks) {
+            task();
+        }
+        return stopping;
+    }
+
+    void dispatch(Task&& task) {
+        if (m_dispatch) {
+            m_dispatch(std::move(task));
+        } else {
+            task();
+        }
+    }
+
+    void rejectAll(std::vector<Waiter>& waiters, const char* reason) {
+        for (Waiter& waiter : waiters) {
+            dispatch([reject = std::move(waiter.reject), reason]() mutable { reject(std::string(reason)); });
+        }
+        waiters.clear();
+    }
+
+    int m_epoll = -1;
+    int m_wakeUp = -1;
+    UniqueFunction<void(Task&&)> m_dispatch;
+
+    std::mutex m_mutex;
+    std::unordered_map<int, Registration> m_registrations;
+    std::vector<Task> m_tasks;
+    bool m_stopping = false;
+
+    std::thread m_thread;
+};
+
+}  // namespace edoren
+
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+namespace edoren {
+
+namespace detail {
+
+// Intrusive reference counted pointer, `T` provides addReference() and releaseReference(). The latter destroys
+// the object once the last reference is gone.
+template <typename T>
+class RefPtr {
+public:
+    RefPtr() noexcept = default;
+
+    RefPtr(std::nullptr_t) noexcept {}
+
+    explicit RefPtr(T* ptr) noexcept : m_ptr(ptr) {
+        if (m_ptr != nullptr) {
+            m_ptr->addReference();
+        }
+    }
+
+    RefPtr(const RefPtr& other) noexcept : RefPtr(other.m_ptr) {}
+
+    RefPtr(RefPtr&& other) noexcept : m_ptr(std::exchange(other.m_ptr, nullptr)) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    RefPtr(RefPtr<U>&& other) noexcept : m_ptr(std::exchange(other.m_ptr, nullptr)) {}
+
+    ~RefPtr() {
+        reset();
+    }
+
+    RefPtr& operator=(RefPtr other) noexcept {
+        std::swap(m_ptr, other.m_ptr);
+        return *this;
+    }
+
+    void reset() noexcept {
+        if (m_ptr != nullptr) {
+            std::exchange(m_ptr, nullptr)->releaseReference();
+        }
+    }
+
+    T* get() const noexcept {
+        return m_ptr;
+    }
+
+    T& operator*() const noexcept {
+        return *m_ptr;
+    }
+
+    T* operator->() const noexcept {
+        return m_ptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return m_ptr != nullptr;
+    }
+
+private:
+    template <typename U>
+    friend class RefPtr;
+
+    T* m_ptr = nullptr;
+};
+
+template <typename T, typename... Args>
+RefPtr<T> makeRef(Args&&... args) {
+    return RefPtr<T>(new T(std::forward<Args>(args)...));
+}
+
+// Base for the objects owned through RefPtr, the count uses the atomics of `Policy`
+template <typename Policy>
+class RefCounted {
+public:
+    RefCounted() = default;
+
+    RefCounted(const RefCounted& other) = delete;
+
+    RefCounted& operator=(const RefCounted& other) = delete;
+
+    void addReference() {
+        m_references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void releaseReference() {
+        if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+protected:
+    virtual ~RefCounted() = default;
+
+private:
+    typename Policy::template Atomic<uint32_t> m_references{0};
+};
+
+}  // namespace detail
+
+}  // namespace edoren
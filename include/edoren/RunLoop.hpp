@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+// Executor that queues the work until the owner of the loop drains it with run() or runOnce(). It is not
+// synchronized, the work must be queued and run from the same thread, which makes it the natural executor for
+// SingleThreaded promises.
+class RunLoop {
+public:
+    using Task = UniqueFunction<void()>;
+
+    RunLoop() = default;
+
+    RunLoop(const RunLoop& other) = delete;
+
+    RunLoop& operator=(const RunLoop& other) = delete;
+
+    template <typename Func>
+    void execute(Func&& func) {
+        m_queue.emplace_back(std::forward<Func>(func));
+    }
+
+    // Runs the oldest queued task, returns false when there was nothing to run
+    bool runOnce() {
+        if (m_queue.empty()) {
+            return false;
+        }
+        Task task = std::move(m_queue.front());
+        m_queue.pop_front();
+        task();
+        return true;
+    }
+
+    // Runs tasks until the queue is empty, including the ones queued while running. Returns how many ran.
+    std::size_t run() {
+        std::size_t count = 0;
+        while (runOnce()) {
+            count++;
+        }
+        return count;
+    }
+
+    std::size_t size() const {
+        return m_queue.size();
+    }
+
+    bool empty() const {
+        return m_queue.empty();
+    }
+
+private:
+    std::deque<Task> m_queue;
+};
+
+}  // namespace edoren
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+
+#include "Executor.hpp"
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+namespace detail {
+
+// Vyukov's intrusive multi-producer single-consumer queue. Pushing is a single exchange, so producers never wait
+// on each other. A pop can miss an item while the producer that pushed it is between its exchange and linking
+// the node, it shows up once that producer is done.
+template <typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+public:
+    MpscQueue() : m_head(new Node()), m_tail(m_head.load(std::memory_order_relaxed)) {}
+
+    MpscQueue(const MpscQueue& other) = delete;
+
+    MpscQueue& operator=(const MpscQueue& other) = delete;
+
+    ~MpscQueue() {
+        while (m_tail != nullptr) {
+            Node* next = m_tail->next.load(std::memory_order_relaxed);
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    // Any thread
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer only, the node holding the popped value becomes the new stub
+    bool pop(T& value) {
+        Node* next = m_tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        delete m_tail;
+        m_tail = next;
+        return true;
+    }
+
+private:
+    alignas(64) std::atomic<Node*> m_head;
+    alignas(64) Node* m_tail;
+};
+
+// Strand running in the calling thread, or null
+inline const void*& currentStrand() {
+    thread_local const void* sStrand = nullptr;
+    return sStrand;
+}
+
+}  // namespace detail
+
+// Executor that runs the work given to it one task at a time and in order, on top of another executor. The
+// strand has no thread, the first task posted to an idle strand schedules a drain on `executor` and the tasks
+// posted meanwhile are picked up by that same drain. Continuations that touch the same state can go through a
+// strand instead of locking it. The strand should outlive the work posted to it.
+template <typename Executor>
+class Strand {
+public:
+    using Task = UniqueFunction<void()>;
+
+    // Tasks run per drain before it yields the executor thread and schedules itself again
+    static constexpr std::size_t sBatchSize = 64;
+
+    explicit Strand(Executor& executor) : m_executor(executor) {
+        static_assert(IsExecutor<Executor>::value, "Executor should provide an execute(func) member function");
+    }
+
+    Strand(const Strand& other) = delete;
+
+    Strand& operator=(const Strand& other) = delete;
+
+    template <typename Func>
+    void execute(Func&& func) {
+        m_queue.push(Task(std::forward<Func>(func)));
+        if (m_pending.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            schedule();
+        }
+    }
+
+    // Whether the calling thread is running a task of this strand
+    bool runningInThisThread() const {
+        return detail::currentStrand() == this;
+    }
+
+private:
+    void schedule() {
+        m_executor.execute([this] { drain(); });
+    }
+
+    // Only one drain runs at a time, the count of pending tasks only drops to zero when the queue is empty
+    void drain() {
+        const void* outer = detail::currentStrand();
+        detail::currentStrand() = this;
+        for (std::size_t i = 0; i < sBatchSize; i++) {
+            Task task;
+            // The task is counted once its push() returned, so its node is linked. The pop can still miss it
+            // while an earlier producer is between the exchange and the link of its own node, two instructions
+            // away from making the rest of the queue reachable. Yielding lets that producer finish if it was
+            // preempted there. Rescheduling the drain instead would recurse on an inline executor.
+            while (!m_queue.pop(task)) {
+                std::this_thread::yield();
+            }
+            task();
+            if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                detail::currentStrand() = outer;
+                return;
+            }
+        }
+        detail::currentStrand() = outer;
+        schedule();
+    }
+
+    Executor& m_executor;
+    detail::MpscQueue<Task> m_queue;
+    std::atomic<std::size_t> m_pending{0};
+};
+
+}  // namespace edoren
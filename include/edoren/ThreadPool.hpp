@@ -0,0 +1,367 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Executor.hpp"
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+namespace detail {
+
+// Chase-Lev work-stealing deque ("Correct and Efficient Work-Stealing for Weak Memory Models", Lê et al.).
+// The owner thread pushes and pops at the bottom, any other thread can steal from the top. `T` should be a
+// pointer, a null pointer is returned when there is nothing to take.
+template <typename T>
+class WorkStealingDeque {
+    struct Array {
+        explicit Array(int64_t capacity) : capacity(capacity), buffer(new std::atomic<T>[capacity]) {}
+
+        T get(int64_t index) const {
+            return buffer[index & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+
+        void put(int64_t index, T item) {
+            buffer[index & (capacity - 1)].store(item, std::memory_order_relaxed);
+        }
+
+        int64_t capacity;
+        std::unique_ptr<std::atomic<T>[]> buffer;
+    };
+
+public:
+    explicit WorkStealingDeque(int64_t capacity = 1024) {
+        m_arrays.push_back(std::make_unique<Array>(capacity));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque& other) = delete;
+
+    WorkStealingDeque& operator=(const WorkStealingDeque& other) = delete;
+
+    // Owner only
+    void push(T item) {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity - 1) {
+            array = grow(array, top, bottom);
+        }
+        array->put(bottom, item);
+        m_bottom.store(bottom + 1, std::memory_order_seq_cst);
+    }
+
+    // Owner only
+    T pop() {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_seq_cst);
+
+        if (top > bottom) {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T item = array->get(bottom);
+        if (top == bottom) {
+            // Last item, race against the thieves for it
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    // Any thread
+    T steal() {
+        int64_t top = m_top.load(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_seq_cst);
+        if (top >= bottom) {
+            return nullptr;
+        }
+        Array* array = m_array.load(std::memory_order_acquire);
+        T item = array->get(top);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    // Approximation, only exact when called by the owner with no concurrent thieves
+    bool empty() const {
+        return m_bottom.load(std::memory_order_seq_cst) <= m_top.load(std::memory_order_seq_cst);
+    }
+
+private:
+    // The old arrays are kept alive until the deque is destroyed, a thief could still be reading from them
+    Array* grow(Array* array, int64_t top, int64_t bottom) {
+        auto newArray = std::make_unique<Array>(array->capacity * 2);
+        for (int64_t i = top; i < bottom; i++) {
+            newArray->put(i, array->get(i));
+        }
+        m_arrays.push_back(std::move(newArray));
+        m_array.store(m_arrays.back().get(), std::memory_order_release);
+        return m_arrays.back().get();
+    }
+
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    alignas(64) std::atomic<Array*> m_array{nullptr};
+    std::vector<std::unique_ptr<Array>> m_arrays;
+};
+
+}  // namespace detail
+
+// Work-stealing thread pool. Every worker owns a Chase-Lev deque, the work submitted from a worker (e.g. the
+// continuations of a promise fulfilled there) goes to its own deque and the rest goes to a global injection
+// queue. Idle workers take work from the injection queue first and then steal from the other workers. The tasks
+// are held in nodes recycled by the workers, so submitting work from a worker doesn't allocate once the pool
+// warmed up (as long as the callable fits in a Task).
+class ThreadPool {
+public:
+    using Task = UniqueFunction<void()>;
+
+    explicit ThreadPool(std::size_t numThreads = std::max(1U, std::thread::hardware_concurrency())) {
+        m_workers.reserve(numThreads);
+        for (std::size_t i = 0; i < numThreads; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+        for (std::size_t i = 0; i < numThreads; i++) {
+            m_workers[i]->thread = std::thread([this, i] { run(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool& other) = delete;
+
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+
+    // Runs all the pending work before joining the workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_signaler.notify_all();
+        for (auto& worker : m_workers) {
+            worker->thread.join();
+        }
+    }
+
+    template <typename Func>
+    void execute(Func&& func) {
+        Task task(std::forward<Func>(func));
+        Worker* worker = GetCurrentWorker();
+        if (worker != nullptr && worker->pool == this) {
+            TaskNode* node = worker->nodes.acquire();
+            node->task = std::move(task);
+            worker->deque.push(node);
+            // Pairs with the re-check done by a worker before going to sleep
+            if (m_sleeping.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_signaler.notify_one();
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_injected.push_back(std::move(task));
+            if (m_sleeping.load(std::memory_order_relaxed) > 0) {
+                m_signaler.notify_one();
+            }
+        }
+        // The workers blocked in Promise::wait() park apart from the idle ones
+        m_parking.notify();
+    }
+
+    std::size_t size() const {
+        return m_workers.size();
+    }
+
+    // Whether the calling thread is one of the workers of this pool
+    bool isWorkerThread() const {
+        Worker* worker = GetCurrentWorker();
+        return worker != nullptr && worker->pool == this;
+    }
+
+    detail::HelperParking& getHelperParking() {
+        return m_parking;
+    }
+
+    // Runs one pending task in the calling thread, returns false when there was nothing to run. The workers
+    // blocked in Promise::wait() call it, so a task waiting on work queued in its own pool doesn't stall it.
+    bool runOnce() {
+        Worker* worker = GetCurrentWorker();
+        std::size_t index = worker != nullptr && worker->pool == this ? worker->index : m_workers.size();
+        if (Task task = findTask(index)) {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // Task queued in the deque of a worker
+    struct TaskNode {
+        Task task;
+        TaskNode* next = nullptr;
+    };
+
+    // Free nodes of a worker, only touched by its own thread. The nodes taken by a thief are given back to the
+    // thief, the number kept is bounded so they can't pile up in a single worker.
+    class NodePool {
+    public:
+        NodePool() = default;
+
+        NodePool(const NodePool& other) = delete;
+
+        NodePool& operator=(const NodePool& other) = delete;
+
+        ~NodePool() {
+            while (m_head != nullptr) {
+                delete std::exchange(m_head, m_head->next);
+            }
+        }
+
+        TaskNode* acquire() {
+            if (m_head == nullptr) {
+                return new TaskNode();
+            }
+            m_size--;
+            return std::exchange(m_head, m_head->next);
+        }
+
+        void release(TaskNode* node) {
+            if (m_size >= sMaxSize) {
+                delete node;
+                return;
+            }
+            node->next = std::exchange(m_head, node);
+            m_size++;
+        }
+
+    private:
+        static constexpr std::size_t sMaxSize = 1024;
+
+        TaskNode* m_head = nullptr;
+        std::size_t m_size = 0;
+    };
+
+    struct Worker {
+        ThreadPool* pool = nullptr;
+        std::size_t index = 0;
+        detail::WorkStealingDeque<TaskNode*> deque;
+        NodePool nodes;
+        std::thread thread;
+    };
+
+    static Worker*& GetCurrentWorker() {
+        thread_local Worker* sWorker = nullptr;
+        return sWorker;
+    }
+
+    void run(std::size_t index) {
+        Worker* self = m_workers[index].get();
+        self->pool = this;
+        self->index = index;
+        GetCurrentWorker() = self;
+        detail::RunOnceHelper<ThreadPool> helper(*this);
+        detail::WaitHelperScope helperScope(&helper);
+
+        while (true) {
+            if (Task task = findTask(index)) {
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+            // Re-check with the worker registered as sleeping, the producers check the count after pushing
+            if (hasWork()) {
+                m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+                continue;
+            }
+            if (m_stopping) {
+                m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+                break;
+            }
+            m_signaler.wait(lock);
+            m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        GetCurrentWorker() = nullptr;
+    }
+
+    // `index` is the worker calling it, or size() for any other thread. Returns an empty task when there is
+    // nothing to run.
+    Task findTask(std::size_t index) {
+        const std::size_t count = m_workers.size();
+        Worker* self = index < count ? m_workers[index].get() : nullptr;
+        if (self != nullptr) {
+            if (TaskNode* node = self->deque.pop()) {
+                return TakeTask(node, self);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_injected.empty()) {
+                Task task = std::move(m_injected.front());
+                m_injected.pop_front();
+                return task;
+            }
+        }
+        for (std::size_t i = 1; i <= count; i++) {
+            std::size_t victim = (index + i) % count;
+            if (victim == index) {
+                continue;
+            }
+            if (TaskNode* node = m_workers[victim]->deque.steal()) {
+                return TakeTask(node, self);
+            }
+        }
+        return Task();
+    }
+
+    // Called with the mutex held
+    bool hasWork() const {
+        if (!m_injected.empty()) {
+            return true;
+        }
+        for (const auto& worker : m_workers) {
+            if (!worker->deque.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves the task out of `node` and recycles it in the pool of `self`, the worker taking it (if any)
+    static Task TakeTask(TaskNode* node, Worker* self) {
+        Task task = std::move(node->task);
+        if (self != nullptr) {
+            self->nodes.release(node);
+        } else {
+            delete node;
+        }
+        return task;
+    }
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_signaler;
+    std::deque<Task> m_injected;
+    std::atomic<std::size_t> m_sleeping{0};
+    bool m_stopping = false;
+    detail::HelperParking m_parking;
+};
+
+}  // namespace edoren
@@ -0,0 +1,325 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "UniqueFunction.hpp"
+
+namespace edoren {
+
+// Hashed hierarchical timer wheel (Varghese & Lauck) serviced by a single thread. Time is split in ticks of
+// `resolution`, each level has 64 slots and every slot of a level spans a whole turn of the level below.
+// A timer is placed in the lowest level its deadline fits in and moves down a level every time the wheel
+// reaches its slot, so arming and cancelling are O(1). Timers expiring in the same tick fire together in a
+// single wakeup, and the thread only wakes up when something expires or has to move down a level.
+// The callbacks run in the wheel thread and should be short, anything heavier should go to an executor.
+class TimerWheel {
+    struct Timer;
+
+public:
+    using Clock = std::chrono::steady_clock;
+    using Callback = UniqueFunction<void()>;
+
+    // Identifies an armed timer, it is safe to cancel it after it fired or was cancelled already
+    struct TimerId {
+        Timer* timer = nullptr;
+        uint32_t generation = 0;
+    };
+
+    explicit TimerWheel(Clock::duration resolution = std::chrono::milliseconds(1))
+          : m_resolution(std::max(resolution, Clock::duration(1))), m_start(Clock::now()) {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    TimerWheel(const TimerWheel& other) = delete;
+
+    TimerWheel& operator=(const TimerWheel& other) = delete;
+
+    // The pending timers are dropped without firing
+    ~TimerWheel() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_signaler.notify_one();
+        m_thread.join();
+    }
+
+    // Wheel shared by the whole process, its thread starts on first use
+    static TimerWheel& Default() {
+        static TimerWheel sWheel;
+        return sWheel;
+    }
+
+    template <typename Rep, typename Period, typename Func>
+    TimerId arm(const std::chrono::duration<Rep, Period>& delay, Func&& func) {
+        return armAt(Clock::now() + std::chrono::ceil<Clock::duration>(delay), std::forward<Func>(func));
+    }
+
+    template <typename Func>
+    TimerId armAt(Clock::time_point deadline, Func&& func) {
+        Callback callback(std::forward<Func>(func));
+        // Rounded up, a timer never fires before its deadline
+        auto elapsed = std::max(deadline - m_start, Clock::duration::zero());
+        uint64_t expiry = static_cast<uint64_t>((elapsed + m_resolution - Clock::duration(1)) / m_resolution);
+
+        bool wakeUp = false;
+        TimerId id;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Timer* timer = allocate();
+            timer->expiry = std::max(expiry, m_now + 1);
+            timer->callback = std::move(callback);
+            insert(timer);
+            m_count++;
+            wakeUp = timer->expiry < m_wakeUpTick;
+            id = TimerId{timer, timer->generation};
+        }
+        if (wakeUp) {
+            m_signaler.notify_one();
+        }
+        return id;
+    }
+
+    // Returns whether the timer was still pending, its callback is destroyed without being called
+    bool cancel(TimerId id) {
+        Callback callback;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            Timer* timer = id.timer;
+            if (timer == nullptr || timer->generation != id.generation || timer->position == sUnlinked) {
+                return false;
+            }
+            unlink(timer);
+            m_count--;
+            callback = std::move(timer->callback);
+            release(timer);
+        }
+        return true;
+    }
+
+    // Number of timers waiting to fire
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_count;
+    }
+
+private:
+    static constexpr unsigned sSlotBits = 6;
+    static constexpr unsigned sSlotsPerLevel = 1U << sSlotBits;
+    static constexpr unsigned sLevels = 6;
+    static constexpr uint16_t sUnlinked = std::numeric_limits<uint16_t>::max();
+    static constexpr uint64_t sNever = std::numeric_limits<uint64_t>::max();
+
+    struct Timer {
+        uint64_t expiry = 0;
+        Timer* prev = nullptr;
+        Timer* next = nullptr;
+        // Bumped every time the timer is released, so stale ids can be told apart
+        uint32_t generation = 0;
+        // level * sSlotsPerLevel + slot, or sUnlinked when not in the wheel
+        uint16_t position = sUnlinked;
+        Callback callback;
+    };
+
+    static unsigned SlotOf(uint64_t tick, unsigned level) {
+        return static_cast<unsigned>(tick >> (level * sSlotBits)) & (sSlotsPerLevel - 1);
+    }
+
+    Timer* allocate() {
+        if (m_free == nullptr) {
+            m_storage.emplace_back();
+            return &m_storage.back();
+        }
+        Timer* timer = m_free;
+        m_free = timer->next;
+        return timer;
+    }
+
+    void release(Timer* timer) {
+        timer->generation++;
+        timer->position = sUnlinked;
+        timer->next = m_free;
+        m_free = timer;
+    }
+
+    // Places the timer in the lowest level where its expiry is less than a full turn of that level away
+    void insert(Timer* timer) {
+        uint64_t delta = timer->expiry > m_now ? timer->expiry - m_now : 0;
+        unsigned level = 0;
+        while (level + 1 < sLevels && delta >= (uint64_t(1) << ((level + 1) * sSlotBits))) {
+            level++;
+        }
+        // Too far away for the top level, it is parked in its last slot and placed again from there
+        uint64_t tick = timer->expiry;
+        if (level + 1 == sLevels && delta >= (uint64_t(1) << (sLevels * sSlotBits))) {
+            tick = m_now + (uint64_t(1) << (sLevels * sSlotBits)) - 1;
+        }
+        unsigned slot = SlotOf(tick, level);
+
+        Timer*& head = m_slots[level][slot];
+        timer->prev = nullptr;
+        timer->next = head;
+        if (head != nullptr) {
+            head->prev = timer;
+        }
+        head = timer;
+        timer->position = static_cast<uint16_t>(level * sSlotsPerLevel + slot);
+        m_occupied[level] |= uint64_t(1) << slot;
+    }
+
+    void unlink(Timer* timer) {
+        unsigned level = timer->position / sSlotsPerLevel;
+        unsigned slot = timer->position % sSlotsPerLevel;
+        if (timer->prev != nullptr) {
+            timer->prev->next = timer->next;
+        } else {
+            m_slots[level][slot] = timer->next;
+        }
+        if (timer->next != nullptr) {
+            timer->next->prev = timer->prev;
+        }
+        if (m_slots[level][slot] == nullptr) {
+            m_occupied[level] &= ~(uint64_t(1) << slot);
+        }
+        timer->position = sUnlinked;
+    }
+
+    Timer* detachSlot(unsigned level, unsigned slot) {
+        Timer* head = m_slots[level][slot];
+        m_slots[level][slot] = nullptr;
+        m_occupied[level] &= ~(uint64_t(1) << slot);
+        return head;
+    }
+
+    // First tick after the current one where a slot has to fire or move down a level
+    uint64_t nextEventTick() const {
+        uint64_t next = sNever;
+        for (unsigned level = 0; level < sLevels; level++) {
+            if (m_occupied[level] == 0) {
+                continue;
+            }
+            // Slots of this level are visited on multiples of its span, starting from the next one
+            unsigned shift = level * sSlotBits;
+            uint64_t turn = (m_now >> shift) + 1;
+            unsigned offset = static_cast<unsigned>(turn) & (sSlotsPerLevel - 1);
+            uint64_t occupied = m_occupied[level];
+            uint64_t rotated = offset == 0 ? occupied : (occupied >> offset) | (occupied << (sSlotsPerLevel - offset));
+            uint64_t tick = (turn + static_cast<uint64_t>(CountTrailingZeros(rotated))) << shift;
+            next = std::min(next, tick);
+        }
+        return next;
+    }
+
+    static unsigned CountTrailingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return static_cast<unsigned>(__builtin_ctzll(value));
+#else
+        unsigned count = 0;
+        while ((value & 1) == 0) {
+            value >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    // Moves the wheel to `tick`, the timers of the upper levels due in this turn are placed again from the
+    // highest level down so they end up in the level 0 slot fired right after. Returns the expired timers.
+    Timer* advanceTo(uint64_t tick) {
+        m_now = tick;
+        for (unsigned level = sLevels - 1; level > 0; level--) {
+            if ((tick & ((uint64_t(1) << (level * sSlotBits)) - 1)) != 0) {
+                continue;
+            }
+            Timer* timer = detachSlot(level, SlotOf(tick, level));
+            while (timer != nullptr) {
+                Timer* next = timer->next;
+                insert(timer);
+                timer = next;
+            }
+        }
+        Timer* expired = detachSlot(0, SlotOf(tick, 0));
+        for (Timer* timer = expired; timer != nullptr; timer = timer->next) {
+            timer->position = sUnlinked;
+            m_count--;
+        }
+        return expired;
+    }
+
+    uint64_t currentTick() const {
+        return static_cast<uint64_t>((Clock::now() - m_start) / m_resolution);
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stopping) {
+            uint64_t now = currentTick();
+            uint64_t next = nextEventTick();
+            while (next <= now) {
+                Timer* expired = advanceTo(next);
+                if (expired != nullptr) {
+                    fire(expired, lock);
+                }
+                now = currentTick();
+                next = nextEventTick();
+            }
+            // Nothing happens until `next`, the ticks in between don't need to be visited
+            if (m_now < now) {
+                m_now = now;
+                next = nextEventTick();
+            }
+
+            m_wakeUpTick = next;
+            if (next == sNever) {
+                m_signaler.wait(lock);
+            } else {
+                m_signaler.wait_until(lock, m_start + m_resolution * next);
+            }
+            m_wakeUpTick = sNever;
+        }
+    }
+
+    // Runs the callbacks of the expired timers with the lock released, the timers are recycled afterwards
+    void fire(Timer* expired, std::unique_lock<std::mutex>& lock) {
+        lock.unlock();
+        for (Timer* timer = expired; timer != nullptr; timer = timer->next) {
+            timer->callback();
+            timer->callback = nullptr;
+        }
+        lock.lock();
+        while (expired != nullptr) {
+            Timer* next = expired->next;
+            release(expired);
+            expired = next;
+        }
+    }
+
+    const Clock::duration m_resolution;
+    const Clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_signaler;
+    Timer* m_slots[sLevels][sSlotsPerLevel] = {};
+    uint64_t m_occupied[sLevels] = {};
+    uint64_t m_now = 0;
+    uint64_t m_wakeUpTick = sNever;
+    std::size_t m_count = 0;
+    bool m_stopping = false;
+
+    // Timers are never freed while the wheel lives, so a stale TimerId always points to valid memory
+    std::deque<Timer> m_storage;
+    Timer* m_free = nullptr;
+
+    std::thread m_thread;
+};
+
+}  // namespace edoren
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace edoren {
+
+template <typename Signature, std::size_t InlineSize = 48>
+class UniqueFunction;
+
+template <typename T>
+struct IsUniqueFunction : public std::false_type {};
+
+template <typename Signature, std::size_t InlineSize>
+struct IsUniqueFunction<UniqueFunction<Signature, InlineSize>> : public std::true_type {};
+
+// Move-only replacement of std::function. Callables up to `InlineSize` bytes are stored in place, bigger ones
+// (or the ones that could throw while being moved) are stored on the heap.
+template <typename Ret, typename... Args, std::size_t InlineSize>
+class UniqueFunction<Ret(Args...), InlineSize> {
+    struct VTable {
+        Ret (*invoke)(void* storage, Args&&... args);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename Func>
+    static constexpr bool sIsInline = sizeof(Func) <= InlineSize && alignof(Func) <= alignof(std::max_align_t) &&
+                                      std::is_nothrow_move_constructible_v<Func>;
+
+    template <typename Func>
+    struct InlineOps {
+        static Func& Get(void* storage) {
+            return *std::launder(reinterpret_cast<Func*>(storage));
+        }
+
+        static Ret Invoke(void* storage, Args&&... args) {
+            return std::invoke(Get(storage), std::forward<Args>(args)...);
+        }
+
+        static void Move(void* dst, void* src) noexcept {
+            new (dst) Func(std::move(Get(src)));
+            Get(src).~Func();
+        }
+
+        static void Destroy(void* storage) noexcept {
+            Get(storage).~Func();
+        }
+
+        static constexpr VTable sVTable = {&Invoke, &Move, &Destroy};
+    };
+
+    template <typename Func>
+    struct HeapOps {
+        static Func*& Get(void* storage) {
+            return *std::launder(reinterpret_cast<Func**>(storage));
+        }
+
+        static Ret Invoke(void* storage, Args&&... args) {
+            return std::invoke(*Get(storage), std::forward<Args>(args)...);
+        }
+
+        static void Move(void* dst, void* src) noexcept {
+            new (dst) Func*(Get(src));
+        }
+
+        static void Destroy(void* storage) noexcept {
+            delete Get(storage);
+        }
+
+        static constexpr VTable sVTable = {&Invoke, &Move, &Destroy};
+    };
+
+public:
+    static_assert(InlineSize >= sizeof(void*), "UniqueFunction inline storage should at least fit a pointer");
+
+    UniqueFunction() noexcept = default;
+
+    UniqueFunction(std::nullptr_t) noexcept {}
+
+    template <typename Func,
+              typename = std::enable_if_t<!IsUniqueFunction<std::decay_t<Func>>::value &&
+                                          std::is_invocable_r_v<Ret, std::decay_t<Func>&, Args...>>>
+    UniqueFunction(Func&& func) {
+        using FuncType = std::decay_t<Func>;
+        if constexpr (sIsInline<FuncType>) {
+            new (m_storage) FuncType(std::forward<Func>(func));
+            m_vtable = &InlineOps<FuncType>::sVTable;
+        } else {
+            new (m_storage) FuncType*(new FuncType(std::forward<Func>(func)));
+            m_vtable = &HeapOps<FuncType>::sVTable;
+        }
+    }
+
+    UniqueFunction(const UniqueFunction& other) = delete;
+
+    UniqueFunction(UniqueFunction&& other) noexcept : m_vtable(other.m_vtable) {
+        if (m_vtable != nullptr) {
+            m_vtable->move(m_storage, other.m_storage);
+            other.m_vtable = nullptr;
+        }
+    }
+
+    ~UniqueFunction() {
+        reset();
+    }
+
+    UniqueFunction& operator=(const UniqueFunction& other) = delete;
+
+    UniqueFunction& operator=(UniqueFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.m_vtable != nullptr) {
+                other.m_vtable->move(m_storage, other.m_storage);
+                m_vtable = other.m_vtable;
+                other.m_vtable = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    UniqueFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    explicit operator bool() const noexcept {
+        return m_vtable != nullptr;
+    }
+
+    Ret operator()(Args... args) {
+        return m_vtable->invoke(m_storage, std::forward<Args>(args)...);
+    }
+
+private:
+    void reset() noexcept {
+        if (m_vtable != nullptr) {
+            m_vtable->destroy(m_storage);
+            m_vtable = nullptr;
+        }
+    }
+
+    const VTable* m_vtable = nullptr;
+    alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+};
+
+}  // namespace edoren
@@ -1,9 +1,9 @@
 #include <iostream>
-#include <thread>
 
 #include <curl/curl.h>
 
 #include <edoren/Promise.hpp>
+#include <edoren/ThreadPool.hpp>
 
 using namespace edoren;
 using namespace std::chrono_literals;
@@ -14,10 +14,10 @@ size_t writeFunction(void* ptr, size_t size, size_t nmemb, std::string* data) {
 }
 
 int main(int argc, const char* argv[]) {
-    std::thread t;
+    ThreadPool pool(2);
 
-    auto prom = Promise<std::string>([&t](auto&& resolve, auto&& reject) {
-                    t = std::thread([resolve, reject] {
+    auto prom = Promise<std::string>([&pool](auto&& resolve, auto&& reject) {
+                    pool.execute([resolve, reject] {
                         auto curl = curl_easy_init();
 
                         curl_easy_setopt(curl, CURLOPT_URL, "https://edoren.me");
@@ -46,9 +46,9 @@ int main(int argc, const char* argv[]) {
                         curl_easy_cleanup(curl);
                         std::cout << "REQUEST FINISHED WITH RESPONSE CODE " << response_code << std::endl;
 
-                        resolve(response_string);
+                        resolve(std::move(response_string));
                     });
-                }).then([](const std::string& value) {
+                }).then(pool, [](const std::string& value) {
         std::cout << value << std::endl;
         // return Promise<long>::Resolve(10);
         return Promise<long>::Reject("FAILED");
@@ -56,7 +56,7 @@ int main(int argc, const char* argv[]) {
 
     std::cout << "HELLO REQUEST" << std::endl;
 
-    t.join();
+    prom.wait();
 
     return 0;
 }
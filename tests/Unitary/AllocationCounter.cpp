@@ -0,0 +1,77 @@
+#include "AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local bool sCountAllocations = false;
+thread_local std::size_t sAllocationCount = 0;
+
+void* allocate(std::size_t size) noexcept {
+    if (sCountAllocations) {
+        sAllocationCount++;
+    }
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+}  // namespace
+
+AllocationCounter::AllocationCounter() {
+    sAllocationCount = 0;
+    sCountAllocations = true;
+}
+
+AllocationCounter::~AllocationCounter() {
+    sCountAllocations = false;
+}
+
+std::size_t AllocationCounter::count() const {
+    return sAllocationCount;
+}
+
+// Every form of the global allocation functions is replaced, so whatever allocates through one of them frees
+// through the matching one. The over-aligned forms are left to the standard library, they aren't counted.
+
+void* operator new(std::size_t size) {
+    if (void* ptr = allocate(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
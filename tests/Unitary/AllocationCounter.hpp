@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts the allocations done by the current thread while it lives. The global operator new of the unit tests
+// reports to it, see AllocationCounter.cpp.
+class AllocationCounter {
+public:
+    AllocationCounter();
+
+    AllocationCounter(const AllocationCounter& other) = delete;
+
+    AllocationCounter& operator=(const AllocationCounter& other) = delete;
+
+    ~AllocationCounter();
+
+    std::size_t count() const;
+};
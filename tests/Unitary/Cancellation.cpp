@@ -0,0 +1,400 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/Cancellation.hpp>
+#include <edoren/Promise.hpp>
+#include <edoren/RunLoop.hpp>
+#include <edoren/ThreadPool.hpp>
+
+using namespace edoren;
+using namespace std::chrono_literals;
+
+TEST_CASE("CancellationSource should be requested only once") {
+    CancellationToken never;
+    REQUIRE(!never.canBeCancelled());
+    REQUIRE(!never.isCancellationRequested());
+
+    CancellationSource source;
+    CancellationToken token = source.getToken();
+    REQUIRE(token.canBeCancelled());
+    REQUIRE(!token.isCancellationRequested());
+
+    REQUIRE(source.requestCancellation());
+    REQUIRE(!source.requestCancellation());
+    REQUIRE(source.isCancellationRequested());
+    REQUIRE(token.isCancellationRequested());
+
+    SECTION("A token can't be cancelled anymore once its sources are gone") {
+        CancellationToken orphan;
+        {
+            CancellationSource other;
+            CancellationSource copy(other);
+            orphan = copy.getToken();
+        }
+        REQUIRE(!orphan.canBeCancelled());
+    }
+}
+
+TEST_CASE("CancellationToken should call the subscribed callbacks once") {
+    CancellationSource source;
+    CancellationToken token = source.getToken();
+    int called = 0;
+    int removed = 0;
+
+    token.subscribe([&called] { called++; });
+    auto registration = token.subscribe([&removed] { removed++; });
+    REQUIRE(token.unsubscribe(registration));
+    REQUIRE(!token.unsubscribe(registration));
+    {
+        CancellationCallback callback(token, [&called] { called++; });
+        {
+            // Unsubscribed on destruction
+            CancellationCallback dropped(token, [&removed] { removed++; });
+        }
+        source.requestCancellation();
+        REQUIRE(called == 2);
+    }
+    source.requestCancellation();
+    REQUIRE(called == 2);
+    REQUIRE(removed == 0);
+
+    // Subscribing once cancelled calls the callback right away
+    auto late = token.subscribe([&called] { called++; });
+    REQUIRE(called == 3);
+    REQUIRE(!token.unsubscribe(late));
+}
+
+TEST_CASE("CancellationCallback should wait for its callback running in another thread") {
+    CancellationSource source;
+    std::atomic<bool> started(false);
+    std::atomic<bool> finished(false);
+    std::thread requester;
+    {
+        CancellationCallback callback(source.getToken(), [&started, &finished] {
+            started = true;
+            std::this_thread::sleep_for(20ms);
+            finished = true;
+        });
+        requester = std::thread([&source] { source.requestCancellation(); });
+        while (!started) {
+            std::this_thread::yield();
+        }
+    }
+    REQUIRE(finished);
+    requester.join();
+}
+
+TEST_CASE("Promise::withCancellation should reject the ongoing promises once cancelled") {
+    CancellationSource source;
+    Promise<int>::ResolveCallback resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                    .withCancellation(source.getToken());
+    REQUIRE(prom.waitFor(0s) == Promise<int>::Status::ONGOING);
+
+    source.requestCancellation();
+    std::string reason;
+    REQUIRE(prom.waitFor(0s) == Promise<int>::Status::REJECTED);
+    prom.failed([&reason](const std::string& val) { reason = val; });
+    REQUIRE(reason == "Promise has been cancelled");
+    REQUIRE(reason == Promise<int>::CancellationReason());
+
+    // Fulfilling it later has no effect
+    resolver(10);
+    REQUIRE(prom.waitFor(0s) == Promise<int>::Status::REJECTED);
+
+    SECTION("The promises fulfilled first are left as they are") {
+        CancellationSource other;
+        int result = 0;
+        auto fulfilled = Promise<int>::Resolve(10).withCancellation(other.getToken());
+        other.requestCancellation();
+        fulfilled.then([&result](const int& val) { result = val; });
+        REQUIRE(result == 10);
+    }
+}
+
+namespace {
+
+enum class Failure { CANCELLED, MOVED, OTHER };
+
+}  // namespace
+
+namespace edoren {
+
+template <>
+struct RejectReason<Failure> {
+    static Failure Cancelled() {
+        return Failure::CANCELLED;
+    }
+
+    static Failure Moved() {
+        return Failure::MOVED;
+    }
+};
+
+}  // namespace edoren
+
+TEST_CASE("Promise cancellation should use the reject reason given for the reject type") {
+    CancellationSource source;
+    Failure reason = Failure::OTHER;
+    auto prom = Promise<int, Failure>([](auto&& resolve, auto&& reject) {}).withCancellation(source.getToken());
+    source.requestCancellation();
+    prom.failed([&reason](const Failure& val) { reason = val; });
+    REQUIRE(reason == Failure::CANCELLED);
+
+    auto moved = std::move(prom);
+    prom.failed([&reason](const Failure& val) { reason = val; });
+    REQUIRE(reason == Failure::MOVED);
+}
+
+TEST_CASE("Promise::then with a cancellation token should skip the rest of the chain") {
+    CancellationSource source;
+    Promise<int>::ResolveCallback resolver;
+    int called = 0;
+    std::string reason;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                    .then(source.getToken(),
+                          [&called](const int& val) {
+                              called++;
+                              return Promise<int>::Resolve(val + 1);
+                          })
+                    .then([&called](const int& val) { called++; })
+                    .failed([&reason](const std::string& val) { reason = val; });
+
+    source.requestCancellation();
+    REQUIRE(reason == "Promise has been cancelled");
+    resolver(10);
+    REQUIRE(called == 0);
+
+    SECTION("When the token is not cancelled") {
+        CancellationSource other;
+        int result = 0;
+        Promise<int>::Resolve(10)
+            .then(other.getToken(), [](const int& val) { return Promise<int>::Resolve(val + 1); })
+            .then([&result](const int& val) { result = val; });
+        REQUIRE(result == 11);
+    }
+}
+
+TEST_CASE("Promise::then with a cancelled token should reject a fulfilled promise") {
+    CancellationSource source;
+    source.requestCancellation();
+    int called = 0;
+    std::string reason;
+
+    SECTION("When the callback returns void") {
+        Promise<int>::Resolve(10)
+            .then(source.getToken(), [&called](const int& val) { called++; })
+            .then([&called](const int& val) { called++; })
+            .failed([&reason](const std::string& val) { reason = val; });
+    }
+    SECTION("When the callback returns a promise") {
+        Promise<int>::Resolve(10)
+            .then(source.getToken(), [&called](const int& val) {
+                called++;
+                return Promise<long>::Resolve(val);
+            })
+            .then([&called](const long& val) { called++; })
+            .failed([&reason](const std::string& val) { reason = val; });
+    }
+    SECTION("When the callback is scheduled on an executor") {
+        RunLoop loop;
+        Promise<int>::Resolve(10)
+            .then(loop, source.getToken(), [&called](const int& val) { called++; })
+            .then([&called](const int& val) { called++; })
+            .failed([&reason](const std::string& val) { reason = val; });
+        loop.run();
+    }
+
+    REQUIRE(called == 0);
+    REQUIRE(reason == "Promise has been cancelled");
+}
+
+TEST_CASE("Promise::then with a cancellation token should skip the callbacks queued on the executor") {
+    RunLoop loop;
+    CancellationSource source;
+    CancellationToken token = source.getToken();
+    int called = 0;
+
+    auto prom = Promise<int>::Resolve(10).then(loop, token, [&called](const int& val) { called++; });
+    auto other = Promise<int>::Resolve(10).then(loop, token, [&called](const int& val) {
+        called++;
+        return Promise<std::string>::Resolve(std::to_string(val));
+    });
+    source.requestCancellation();
+    REQUIRE(prom.waitFor(0s) == Promise<int>::Status::REJECTED);
+    REQUIRE(other.waitFor(0s) == Promise<std::string>::Status::REJECTED);
+
+    loop.run();
+    REQUIRE(called == 0);
+}
+
+TEST_CASE("Promise::withCancellation should apply to the combinators") {
+    CancellationSource source;
+    Promise<int>::ResolveCallback resolver;
+    auto pending = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+    std::vector<Promise<int>> promises{Promise<int>::Resolve(1), pending};
+    auto prom = Promise<std::vector<int>>::All(promises.begin(), promises.end()).withCancellation(source.getToken());
+
+    source.requestCancellation();
+    std::string reason;
+    prom.failed([&reason](const std::string& val) { reason = val; });
+    REQUIRE(reason == "Promise has been cancelled");
+    resolver(2);
+    REQUIRE(prom.waitFor(0s) == Promise<std::vector<int>>::Status::REJECTED);
+}
+
+TEST_CASE("Promise cancellation should race safely with the producers") {
+    constexpr int numPromises = 2000;
+    ThreadPool pool(4);
+    CancellationSource source;
+    std::atomic<int> called(0);
+
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < numPromises; i++) {
+        promises.push_back(Promise<int>([&pool, i](auto&& resolve, auto&& reject) {
+                               pool.execute([resolve, i] { resolve(i); });
+                           }).then(pool, source.getToken(), [&called](const int& val) {
+            called++;
+            return Promise<int>::Resolve(val);
+        }));
+    }
+    source.requestCancellation();
+
+    int resolved = 0;
+    int cancelled = 0;
+    for (auto& prom : promises) {
+        auto status = prom.waitFor(5s);
+        if (status == Promise<int>::Status::RESOLVED) {
+            resolved++;
+        } else if (status == Promise<int>::Status::REJECTED) {
+            std::string reason;
+            prom.failed([&reason](const std::string& val) { reason = val; });
+            cancelled += reason == "Promise has been cancelled" ? 1 : 0;
+        }
+    }
+    REQUIRE(resolved + cancelled == numPromises);
+    REQUIRE(resolved <= called);
+}
+
+TEST_CASE("Promise should cancel its producer once every handle is dropped") {
+    CancellationToken producer;
+    Promise<int>::ResolveCallback resolver;
+    auto prom = std::make_unique<Promise<int>>([&producer, &resolver](auto&& resolve, auto&& reject, auto&& token) {
+        producer = token;
+        resolver = resolve;
+    });
+    REQUIRE(producer.canBeCancelled());
+
+    SECTION("When the handles are dropped") {
+        auto copy = std::make_unique<Promise<int>>(*prom);
+        prom.reset();
+        REQUIRE(!producer.isCancellationRequested());
+        copy.reset();
+        REQUIRE(producer.isCancellationRequested());
+        // Fulfilling it afterwards has no effect
+        resolver(10);
+    }
+    SECTION("When the promises chained after it are dropped") {
+        RunLoop loop;
+        auto data = std::make_shared<int>(0);
+        std::weak_ptr<int> observer = data;
+        auto chained = std::make_unique<Promise<int>>(
+            prom->then([data](const int& val) { return Promise<int>::Resolve(val + *data); })
+                .via(loop)
+                .then([](const int& val) {}));
+        data.reset();
+        prom.reset();
+        REQUIRE(!producer.isCancellationRequested());
+        chained.reset();
+        REQUIRE(producer.isCancellationRequested());
+        // The continuations are released right away
+        REQUIRE(observer.expired());
+    }
+    SECTION("When a continuation still wants the result") {
+        int result = 0;
+        prom->failed([](const std::string& val) {}).then([&result](const int& val) { result = val; });
+        prom.reset();
+        REQUIRE(!producer.isCancellationRequested());
+        resolver(10);
+        REQUIRE(result == 10);
+    }
+    SECTION("When the promise is fulfilled first") {
+        resolver(10);
+        prom.reset();
+        REQUIRE(!producer.isCancellationRequested());
+    }
+    SECTION("When the producer is dropped without fulfilling it") {
+        auto data = std::make_shared<int>(0);
+        std::weak_ptr<int> observer = data;
+        prom->then([data](const int& val) { return Promise<int>::Resolve(val + *data); })
+            .failed([data](const std::string& val) {});
+        data.reset();
+        prom.reset();
+        REQUIRE(!observer.expired());
+        // Nothing can fulfill it anymore, the whole chain is released
+        resolver = nullptr;
+        REQUIRE(observer.expired());
+    }
+}
+
+TEST_CASE("Promise should release the callbacks its producer subscribed once settled") {
+    auto data = std::make_shared<int>(0);
+    std::weak_ptr<int> observer = data;
+    Promise<int>::ResolveCallback resolver;
+    int stopped = 0;
+    auto prom = std::make_unique<Promise<int>>([&](auto&& resolve, auto&& reject, auto&& token) {
+        token.subscribe([reject, data, &stopped] {
+            stopped++;
+            reject("stopped");
+        });
+        token.subscribe([data, &stopped] { stopped++; });
+        resolver = resolve;
+    });
+    data.reset();
+    REQUIRE(!observer.expired());
+
+    SECTION("When the promise is resolved") {
+        resolver(10);
+        REQUIRE(observer.expired());
+        prom.reset();
+        REQUIRE(stopped == 0);
+    }
+    SECTION("When the promise is abandoned") {
+        prom.reset();
+        // Every callback runs, even once the first one rejected the promise
+        REQUIRE(stopped == 2);
+        REQUIRE(observer.expired());
+    }
+}
+
+TEST_CASE("Promise should let its producer stop the abandoned work") {
+    ThreadPool pool(2);
+    std::atomic<bool> stopped(false);
+    std::atomic<bool> started(false);
+    {
+        auto prom = Promise<int>([&pool, &started, &stopped](auto&& resolve, auto&& reject, auto&& token) {
+            pool.execute([resolve, reject, token, &started, &stopped] {
+                started = true;
+                while (!token.isCancellationRequested()) {
+                    std::this_thread::yield();
+                }
+                stopped = true;
+                resolve(10);
+            });
+        });
+        while (!started) {
+            std::this_thread::yield();
+        }
+    }
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!stopped && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    REQUIRE(stopped);
+}
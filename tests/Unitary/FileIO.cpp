@@ -0,0 +1,120 @@
+#if defined(__linux__)
+
+    #include <fcntl.h>
+    #include <unistd.h>
+
+    #include <cstdlib>
+    #include <string>
+    #include <vector>
+
+    #include <catch2/catch.hpp>
+
+    #include <edoren/FileIO.hpp>
+
+using namespace edoren;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Temporary file removed when going out of scope
+struct TemporaryFile {
+    TemporaryFile() {
+        char pattern[] = "/tmp/edoren-fileio-XXXXXX";
+        fd = ::mkstemp(pattern);
+        path = pattern;
+    }
+
+    ~TemporaryFile() {
+        ::close(fd);
+        ::unlink(path.c_str());
+    }
+
+    void write(const std::string& content) {
+        REQUIRE(::pwrite(fd, content.data(), content.size(), 0) == static_cast<ssize_t>(content.size()));
+    }
+
+    int fd = -1;
+    std::string path;
+};
+
+template <typename T>
+T get(Promise<T>& prom) {
+    REQUIRE(prom.waitFor(5s) == Promise<T>::Status::RESOLVED);
+    T result{};
+    prom.then([&result](const T& val) { result = val; });
+    return result;
+}
+
+std::string get(Promise<FileIO::Buffer>&& prom) {
+    FileIO::Buffer buffer = get(prom);
+    return std::string(buffer.begin(), buffer.end());
+}
+
+std::string getError(Promise<FileIO::Buffer>&& prom) {
+    REQUIRE(prom.waitFor(5s) == Promise<FileIO::Buffer>::Status::REJECTED);
+    std::string reason;
+    prom.failed([&reason](const std::string& val) { reason = val; });
+    return reason;
+}
+
+}  // namespace
+
+TEST_CASE("FileIO should read and write files asynchronously") {
+    auto backend = GENERATE(FileIO::Backend::IO_URING, FileIO::Backend::THREAD_POOL);
+    FileIO io(backend);
+    if (backend == FileIO::Backend::THREAD_POOL) {
+        REQUIRE(io.getBackend() == FileIO::Backend::THREAD_POOL);
+    }
+
+    SECTION("When reading a whole file") {
+        TemporaryFile file;
+        std::string content(100000, 'a');
+        content[99999] = 'z';
+        file.write(content);
+        REQUIRE(get(io.readFile(file.path)) == content);
+    }
+    SECTION("When reading an empty file") {
+        TemporaryFile file;
+        REQUIRE(get(io.readFile(file.path)).empty());
+    }
+    SECTION("When reading a file that does not exist") {
+        REQUIRE(getError(io.readFile("/tmp/edoren-fileio-missing")) == std::strerror(ENOENT));
+    }
+    SECTION("When reading and writing at an offset") {
+        TemporaryFile file;
+        file.write("hello world");
+        auto written = io.pwrite(file.fd, FileIO::Buffer{'W', 'O'}, 6);
+        REQUIRE(get(written) == 2);
+        auto synced = io.fsync(file.fd);
+        REQUIRE(synced.waitFor(5s) == Promise<void>::Status::RESOLVED);
+        REQUIRE(get(io.pread(file.fd, 5, 6)) == "WOrld");
+        // Short read at the end of the file
+        REQUIRE(get(io.pread(file.fd, 100, 9)) == "ld");
+    }
+    SECTION("When the descriptor is not valid") {
+        REQUIRE(getError(io.pread(-1, 10, 0)) == std::strerror(EBADF));
+    }
+}
+
+TEST_CASE("FileIO should handle many requests at the same time") {
+    auto backend = GENERATE(FileIO::Backend::IO_URING, FileIO::Backend::THREAD_POOL);
+    FileIO io(backend, 32);
+
+    std::vector<TemporaryFile> files(300);
+    for (std::size_t i = 0; i < files.size(); i++) {
+        files[i].write(std::to_string(i));
+    }
+
+    // More requests than entries in the ring, the extra ones wait for room
+    std::vector<Promise<FileIO::Buffer>> reads;
+    for (auto& file : files) {
+        reads.push_back(io.readFile(file.path));
+    }
+    bool allRead = true;
+    for (std::size_t i = 0; i < reads.size(); i++) {
+        allRead = get(std::move(reads[i])) == std::to_string(i) && allRead;
+    }
+    REQUIRE(allRead);
+}
+
+#endif
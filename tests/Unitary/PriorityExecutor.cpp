@@ -0,0 +1,126 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/PriorityExecutor.hpp>
+#include <edoren/Promise.hpp>
+
+using namespace edoren;
+
+TEST_CASE("PriorityExecutor should run the most urgent work first") {
+    PriorityExecutor executor(0);
+    std::vector<std::string> calls;
+    executor.execute([&calls] { calls.push_back("low"); }, Priority::LOW);
+    executor.execute([&calls] { calls.push_back("normal"); });
+    executor.execute([&calls] { calls.push_back("high"); }, Priority::HIGH);
+
+    REQUIRE(executor.getLaneStats(Priority::HIGH).depth == 1);
+    REQUIRE(executor.getLaneStats(Priority::NORMAL).depth == 1);
+    REQUIRE(executor.getLaneStats(Priority::LOW).depth == 1);
+    REQUIRE(executor.run() == 3);
+    REQUIRE(calls == std::vector<std::string>{"high", "normal", "low"});
+    REQUIRE(!executor.runOnce());
+}
+
+TEST_CASE("PriorityExecutor should not starve the less urgent lanes") {
+    PriorityExecutor executor(0);
+    std::vector<Priority> calls;
+    // Every high priority task queues another one, the lane is never empty
+    std::function<void()> high = [&] {
+        calls.push_back(Priority::HIGH);
+        executor.execute(high, Priority::HIGH);
+    };
+    executor.execute(high, Priority::HIGH);
+    for (int i = 0; i < 3; i++) {
+        executor.execute([&calls] { calls.push_back(Priority::NORMAL); });
+        executor.execute([&calls] { calls.push_back(Priority::LOW); }, Priority::LOW);
+    }
+
+    for (int i = 0; i < 21; i++) {
+        REQUIRE(executor.runOnce());
+    }
+    int normal = 0;
+    int low = 0;
+    for (Priority priority : calls) {
+        normal += priority == Priority::NORMAL ? 1 : 0;
+        low += priority == Priority::LOW ? 1 : 0;
+    }
+    // The rounds take 4 high, 2 normal and 1 low tasks, or less once a lane runs dry
+    REQUIRE(normal == 3);
+    REQUIRE(low == 3);
+    REQUIRE(calls.size() == 21);
+    REQUIRE(calls[4] == Priority::NORMAL);
+    REQUIRE(calls[6] == Priority::LOW);
+
+    // Lets the last high priority task go
+    high = [&calls] { calls.push_back(Priority::HIGH); };
+    executor.run();
+}
+
+TEST_CASE("PriorityExecutor should report the depth of each lane") {
+    PriorityExecutor executor(0);
+    for (int i = 0; i < 5; i++) {
+        executor.execute([] {}, Priority::LOW);
+    }
+    executor.execute([] {}, Priority::HIGH);
+
+    auto low = executor.getLaneStats(Priority::LOW);
+    REQUIRE(low.depth == 5);
+    REQUIRE(low.maxDepth == 5);
+    REQUIRE(low.executed == 0);
+
+    REQUIRE(executor.runOnce());
+    REQUIRE(executor.runOnce());
+    low = executor.getLaneStats(Priority::LOW);
+    REQUIRE(low.depth == 4);
+    REQUIRE(low.maxDepth == 5);
+    REQUIRE(low.executed == 1);
+    REQUIRE(executor.getLaneStats(Priority::HIGH).executed == 1);
+    REQUIRE(executor.getLaneStats(Priority::NORMAL).maxDepth == 0);
+}
+
+TEST_CASE("PriorityExecutor should run all the pending work before being destroyed") {
+    std::atomic<int> count(0);
+    {
+        PriorityExecutor executor(2);
+        for (int i = 0; i < 1000; i++) {
+            executor.execute([&count] { count++; }, static_cast<Priority>(i % 3));
+        }
+    }
+    REQUIRE(count == 1000);
+}
+
+TEST_CASE("Promise continuations can be given a priority") {
+    SECTION("When the executor is run manually") {
+        PriorityExecutor executor(0);
+        std::vector<std::string> calls;
+        auto low = Promise<int>::Resolve(1).then(executor, Priority::LOW, [&calls](const int& val) {
+            calls.push_back("low " + std::to_string(val));
+        });
+        auto high = Promise<int>::Resolve(2).via(executor, Priority::HIGH).then([&calls](const int& val) {
+            calls.push_back("high " + std::to_string(val));
+        });
+
+        REQUIRE(calls.empty());
+        REQUIRE(executor.getLaneStats(Priority::LOW).depth == 1);
+        REQUIRE(executor.getLaneStats(Priority::HIGH).depth == 1);
+        REQUIRE(executor.run() == 2);
+        REQUIRE(calls == std::vector<std::string>{"high 2", "low 1"});
+        REQUIRE(low.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+        REQUIRE(high.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+    }
+    SECTION("When the executor has its own threads") {
+        PriorityExecutor executor;
+        auto prom = Promise<int>::Resolve(10).then(executor, Priority::HIGH, [](const int& val) {
+            return Promise<int>::Resolve(val * 2);
+        });
+        REQUIRE(prom.waitFor(std::chrono::seconds(5)) == Promise<int>::Status::RESOLVED);
+        int result = 0;
+        prom.then([&result](const int& val) { result = val; });
+        REQUIRE(result == 20);
+    }
+}
@@ -1,12 +1,44 @@
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
 #include <thread>
+#include <tuple>
+#include <vector>
 
 #include <catch2/catch.hpp>
 
 #include <edoren/Promise.hpp>
 
+#include "AllocationCounter.hpp"
+
 using namespace edoren;
 
+// Executor that queues the work until it's explicitly run
+class QueueExecutor {
+public:
+    void execute(UniqueFunction<void()> func) {
+        m_queue.push_back(std::move(func));
+    }
+
+    std::size_t runAll() {
+        std::size_t count = 0;
+        while (!m_queue.empty()) {
+            auto func = std::move(m_queue.front());
+            m_queue.erase(m_queue.begin());
+            func();
+            count++;
+        }
+        return count;
+    }
+
+private:
+    std::vector<UniqueFunction<void()>> m_queue;
+};
+
 template <typename CallbackFn, typename Val>
 std::thread AsyncTask(CallbackFn&& callback, Val&& value, long double duration = 0.25) {
     return std::thread([callback, value, duration] {
@@ -57,6 +89,176 @@ TEST_CASE("Promise::Reject should fail the promise with a reason") {
     REQUIRE(result == "1");
 }
 
+TEST_CASE("Promise should support result types that are not default constructible") {
+    struct Response {
+        explicit Response(int code) : code(code) {}
+
+        int code;
+    };
+
+    int result = 0;
+    std::function<void(const Response&)> resolver;
+    Promise<Response>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+        .then([&result](const Response& response) { result = response.code; });
+    resolver(Response(200));
+    REQUIRE(result == 200);
+
+    Promise<Response>::Resolve(Response(404)).then([&result](const Response& response) { result = response.code; });
+    REQUIRE(result == 404);
+}
+
+TEST_CASE("Promise<void> callbacks should take no value") {
+    Promise<void>::ResolveCallback resolver;
+    std::vector<std::string> calls;
+    Promise<void>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+        .then([&calls]() { calls.push_back("then"); })
+        .then([&calls]() { return Promise<int>::Resolve(10); })
+        .then([&calls](const int& val) {
+            calls.push_back("then " + std::to_string(val));
+            return Promise<void>::Resolve();
+        })
+        .finally([&calls]() { calls.push_back("finally"); });
+    resolver();
+    REQUIRE(calls == std::vector<std::string>{"then", "then 10", "finally"});
+
+    std::string reason;
+    Promise<void>::Reject("FAIL")
+        .then([&calls]() { calls.push_back("never"); })
+        .failed([&reason](const std::string& val) { reason = val; });
+    REQUIRE(reason == "FAIL");
+}
+
+TEST_CASE("Promise should move the result along a chain nobody else observes") {
+    struct Body {
+        Body() = default;
+
+        Body(const Body& other) : copies(other.copies + 1) {}
+
+        Body(Body&& other) noexcept = default;
+
+        int copies = 0;
+    };
+
+    SECTION("When the values are copyable") {
+        int copies = -1;
+        std::function<void(Body&&)> resolver;
+        Promise<Body>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+            .then([](const Body& body) {})
+            .then([](const Body& body) {})
+            .then([](Body body) { return Promise<Body>::Resolve(std::move(body)); })
+            .then([](const Body& body) {})
+            .then([&copies](const Body& body) { copies = body.copies; });
+        resolver(Body());
+        REQUIRE(copies == 0);
+    }
+    SECTION("When the values are move-only") {
+        int result = 0;
+        std::function<void(std::unique_ptr<int>&&)> resolver;
+        Promise<std::unique_ptr<int>>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+            .then([](const std::unique_ptr<int>& value) { *value += 1; })
+            .then([](std::unique_ptr<int> value) {
+                *value += 1;
+                return Promise<std::unique_ptr<int>>::Resolve(std::move(value));
+            })
+            .then([&result](std::unique_ptr<int> value) { result = *value; });
+        resolver(std::make_unique<int>(10));
+        REQUIRE(result == 12);
+    }
+    SECTION("When the Promise is still referenced by a handle") {
+        int copies = -1;
+        std::function<void(Body&&)> resolver;
+        auto prom = Promise<Body>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        prom.then([&copies](Body body) { copies = body.copies; });
+        resolver(Body());
+        REQUIRE(copies == 1);
+        prom.then([&copies](const Body& body) { copies = body.copies; });
+        REQUIRE(copies == 0);
+    }
+    SECTION("When several callbacks only take an rvalue") {
+        std::vector<std::size_t> sizes;
+        auto record = [&sizes](std::string&& value) {
+            std::string taken = std::move(value);
+            sizes.push_back(taken.size());
+        };
+        std::function<void(std::string&&)> resolver;
+        auto prom = Promise<std::string>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        prom.then(record);
+        prom.then(record);
+        resolver(std::string(50, 'a'));
+        prom.then(record);
+        REQUIRE(sizes == std::vector<std::size_t>{50, 50, 50});
+
+        // The same goes for the copies of a ready handle
+        auto ready = Promise<std::string>::Resolve(std::string(50, 'a'));
+        auto copy = ready;
+        ready.then(record);
+        copy.then(record);
+        REQUIRE(sizes == std::vector<std::size_t>{50, 50, 50, 50, 50});
+    }
+}
+
+TEST_CASE("Promise should not copy the large result of a ready handle") {
+    struct Counted {
+        explicit Counted(int* copies = nullptr) : copies(copies) {}
+
+        Counted(const Counted& other) : copies(other.copies) {
+            if (copies != nullptr) {
+                *copies += 1;
+            }
+        }
+
+        Counted(Counted&& other) noexcept = default;
+
+        int* copies;
+    };
+
+    int copies = 0;
+
+    SECTION("When several callbacks are attached to the same handle") {
+        auto prom = Promise<Counted>::Resolve(Counted(&copies));
+        for (int i = 0; i < 5; i++) {
+            prom.then([](const Counted& value) {});
+        }
+        REQUIRE(copies == 0);
+    }
+    SECTION("When the handle is copied") {
+        auto prom = Promise<Counted>::Resolve(Counted(&copies));
+        auto copy = prom;
+        auto other = copy;
+        std::vector<Promise<Counted>> handles(3, prom);
+        other.then([](const Counted& value) {});
+        REQUIRE(copies == 0);
+    }
+    SECTION("When a rejection is passed along") {
+        auto prom = Promise<int, Counted>::Reject(Counted(&copies));
+        for (int i = 0; i < 5; i++) {
+            prom.then([](const int& value) {});
+            prom.then([](const int& value) { return Promise<int, Counted>::Resolve(value); });
+        }
+        REQUIRE(copies == 0);
+    }
+    SECTION("When the result is kept inline") {
+        // Only the results trivially copyable and up to two words are kept in the handle
+        REQUIRE(sizeof(Promise<std::array<char, 256>>) == sizeof(Promise<std::string>));
+        REQUIRE(sizeof(Promise<std::string>) < sizeof(Promise<std::array<void*, 2>, int>));
+    }
+}
+
+TEST_CASE("Promise callbacks can capture move-only types") {
+    std::string result;
+    std::function<void(const int&)> resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+    prom.then([prefix = std::make_unique<std::string>("then ")](const int& val) {
+            return Promise<std::string>::Resolve(*prefix + std::to_string(val));
+        })
+        .then([&result, suffix = std::make_unique<std::string>("!")](const std::string& val) {
+            result = val + *suffix;
+        })
+        .finally([&result, suffix = std::make_unique<std::string>(" finally")]() { result += *suffix; });
+    resolver(10);
+    REQUIRE(result == "then 10! finally");
+}
+
 TEST_CASE("Promise::finally should be called after the promise is fulfilled") {
     SECTION("When the Promise is resolved") {
         std::string result;
@@ -111,7 +313,723 @@ TEST_CASE("Promise::then should be called after the promise is fulfilled") {
     }
 }
 
-// TEST_CASE("Promise::wait should wait for the promise to complete") {
-//     SECTION("When the Promise is resolved synchronously") {
-//     }
-// }
+TEST_CASE("Promise::then should forward the outcome of an ongoing promise") {
+    SECTION("When the Promise is resolved") {
+        std::vector<std::string> calls;
+        std::function<void(const int&)> resolver;
+        Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+            .then([&calls](const int& val) { calls.push_back("then " + std::to_string(val)); })
+            .then([&calls](const int& val) { calls.push_back("then " + std::to_string(val + 1)); })
+            .failed([&calls](const std::string& reason) { calls.push_back("failed"); })
+            .finally([&calls]() { calls.push_back("finally"); });
+        resolver(1);
+        REQUIRE(calls == std::vector<std::string>{"then 1", "then 2", "finally"});
+    }
+    SECTION("When the Promise is rejected") {
+        std::vector<std::string> calls;
+        std::function<void(const std::string&)> rejecter;
+        Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; })
+            .then([&calls](const int& val) { calls.push_back("then"); })
+            .then([&calls](const int& val) { return Promise<long>::Resolve(val); })
+            .failed([&calls](const std::string& reason) { calls.push_back("failed " + reason); })
+            .finally([&calls]() { calls.push_back("finally"); });
+        rejecter("FAIL");
+        REQUIRE(calls == std::vector<std::string>{"failed FAIL", "finally"});
+    }
+}
+
+TEST_CASE("Promise::then on an ongoing promise should only allocate the new state") {
+    std::function<void(const int&)> resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+
+    int result = 0;
+    {
+        AllocationCounter counter;
+        prom.then([&result](const int& val) { result += val; })
+            .then([&result](const int& val) { result += val; })
+            .then([&result](const int& val) { result += val; });
+        REQUIRE(counter.count() == 3);
+    }
+
+    resolver(1);
+    REQUIRE(result == 3);
+}
+
+TEST_CASE("Promise::Resolve and Promise::Reject should not allocate for small results") {
+    SECTION("When the Promise is resolved") {
+        int result = 0;
+        AllocationCounter counter;
+        auto prom = Promise<int>::Resolve(10);
+        prom.then([&result](const int& val) { result = val; })
+            .then([](const int& val) { return Promise<long>::Resolve(val + 1); })
+            .then([&result](const long& val) { result += static_cast<int>(val); });
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+        REQUIRE(counter.count() == 0);
+        REQUIRE(result == 21);
+    }
+    SECTION("When the Promise is rejected") {
+        int result = 0;
+        AllocationCounter counter;
+        Promise<int, int>::Reject(10)
+            .then([&result](const int& val) { result = val; })
+            .then([](const int& val) { return Promise<long, int>::Resolve(val); })
+            .failed([&result](const int& reason) { result = reason; });
+        REQUIRE(counter.count() == 0);
+        REQUIRE(result == 10);
+    }
+    SECTION("When the Promise is moved") {
+        std::string result;
+        auto prom = Promise<std::string>::Resolve("Hello World");
+        auto other = std::move(prom);
+        other.then([&result](const std::string& val) { result = val; });
+        prom.failed([&result](const std::string& reason) { result += " - " + reason; });
+        REQUIRE(result == "Hello World - Promise has been moved");
+    }
+}
+
+TEST_CASE("Promise::then should forward the promise returned by the callback") {
+    // Asynchronous loop, every iteration waits on a step that is resolved later from a queue
+    struct Loop {
+        Promise<int> step(int iteration) {
+            return Promise<int>([this, iteration](auto&& resolve, auto&& reject) {
+                pending.push_back([resolve, iteration] { resolve(iteration + 1); });
+            });
+        }
+
+        Promise<int> run(int iteration) {
+            return step(iteration).then([this](const int& next) {
+                return next == iterations ? Promise<int>::Resolve(next) : run(next);
+            });
+        }
+
+        int iterations = 0;
+        std::vector<std::function<void()>> pending;
+    };
+
+    Loop loop;
+    loop.iterations = 100000;
+
+    int result = 0;
+    loop.run(0).then([&result](const int& val) { result = val; });
+    while (!loop.pending.empty()) {
+        auto next = std::move(loop.pending.back());
+        loop.pending.pop_back();
+        next();
+    }
+    REQUIRE(result == loop.iterations);
+}
+
+TEST_CASE("Promise should fulfill a long chain of ongoing promises without recursing") {
+    SECTION("When the callbacks return void") {
+        std::function<void(const int&)> resolver;
+        std::vector<Promise<int>> chain;
+        chain.push_back(Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; }));
+        int calls = 0;
+        for (int i = 0; i < 100000; i++) {
+            chain.push_back(chain.back().then([&calls](const int& val) { calls++; }));
+        }
+        resolver(10);
+        REQUIRE(calls == 100000);
+    }
+    SECTION("When the callbacks return another Promise") {
+        std::function<void(const int&)> resolver;
+        std::vector<Promise<int>> chain;
+        chain.push_back(Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; }));
+        for (int i = 0; i < 100000; i++) {
+            chain.push_back(chain.back().then([](const int& val) { return Promise<int>::Resolve(val + 1); }));
+        }
+        resolver(0);
+        int result = 0;
+        chain.back().then([&result](const int& val) { result = val; });
+        REQUIRE(result == 100000);
+    }
+}
+
+TEST_CASE("TrampolineExecutor should queue the work nested past the maximum depth") {
+    const std::size_t maxDepth = TrampolineExecutor::GetMaxDepth();
+    TrampolineExecutor::SetMaxDepth(2);
+
+    TrampolineExecutor executor;
+    std::vector<std::string> calls;
+    executor.execute([&executor, &calls] {
+        executor.execute([&executor, &calls] {
+            executor.execute([&calls] { calls.push_back("third"); });
+            calls.push_back("second");
+        });
+        calls.push_back("first");
+    });
+
+    TrampolineExecutor::SetMaxDepth(maxDepth);
+    REQUIRE(calls == std::vector<std::string>{"second", "first", "third"});
+}
+
+TEST_CASE("Promise::wait should run the continuations queued in the trampoline") {
+    const std::size_t maxDepth = TrampolineExecutor::GetMaxDepth();
+    TrampolineExecutor::SetMaxDepth(1);
+
+    Promise<int>::ResolveCallback resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                    .then([](const int& val) { return Promise<int>::Resolve(val + 1); });
+    int result = 0;
+    TrampolineExecutor executor;
+    executor.execute([&resolver, &prom, &result] {
+        // Too deep, the continuations are queued until the outermost call returns
+        resolver(10);
+        prom.wait();
+        prom.then([&result](const int& val) { result = val; });
+    });
+
+    TrampolineExecutor::SetMaxDepth(maxDepth);
+    REQUIRE(result == 11);
+}
+
+TEST_CASE("Promise::wait should not block in a continuation running past the trampoline depth") {
+    // Every promise of the chain is fulfilled by the continuation of the previous one, the last continuation runs
+    // as deep as the trampoline allows
+    const std::size_t depth = TrampolineExecutor::GetMaxDepth();
+    std::vector<Promise<int>::ResolveCallback> resolvers(depth);
+    std::vector<Promise<int>> chain;
+    for (std::size_t i = 0; i < depth; i++) {
+        chain.push_back(Promise<int>([&resolvers, i](auto&& resolve, auto&& reject) { resolvers[i] = resolve; }));
+    }
+    for (std::size_t i = 0; i + 1 < depth; i++) {
+        chain[i].then([&resolvers, i](const int& val) { resolvers[i + 1](val + 1); });
+    }
+
+    Promise<int>::ResolveCallback resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+    auto waited = prom.then([](const int& val) { return Promise<int>::Resolve(val * 2); });
+    int result = 0;
+    chain.back().then([&resolver, &waited, &result](const int& val) {
+        // Too deep, the continuations of the promise are queued in the trampoline of the outermost frame
+        resolver(val);
+        REQUIRE(waited.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::ONGOING);
+        REQUIRE(waited.waitFor(std::chrono::seconds(5)) == Promise<int>::Status::RESOLVED);
+        waited.then([&result](const int& val) { result = val; });
+    });
+    resolvers[0](0);
+    REQUIRE(result == 2 * static_cast<int>(depth - 1));
+}
+
+TEST_CASE("Promise continuations queued in the trampoline should keep their order") {
+    const std::size_t maxDepth = TrampolineExecutor::GetMaxDepth();
+    TrampolineExecutor::SetMaxDepth(1);
+
+    Promise<int>::ResolveCallback resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+    std::vector<std::string> calls;
+    prom.then([&calls](const int& val) { calls.push_back("then"); });
+    TrampolineExecutor executor;
+    executor.execute([&resolver, &prom, &calls] {
+        // Too deep, the continuations attached afterwards are queued behind the ones already there
+        resolver(10);
+        prom.then([&calls](const int& val) { calls.push_back("late then"); });
+        prom.finally([&calls]() { calls.push_back("late finally"); });
+        REQUIRE(calls.empty());
+    });
+
+    TrampolineExecutor::SetMaxDepth(maxDepth);
+    REQUIRE(calls == std::vector<std::string>{"then", "late then", "late finally"});
+}
+
+TEST_CASE("Promise continuations can be scheduled on an executor") {
+    SECTION("When the Promise is already resolved") {
+        QueueExecutor executor;
+        std::vector<std::string> calls;
+        auto prom = Promise<int>::Resolve(10)
+                        .then(executor, [&calls](const int& val) { calls.push_back("then " + std::to_string(val)); })
+                        .finally(executor, [&calls]() { calls.push_back("finally"); });
+        REQUIRE(calls.empty());
+        REQUIRE(executor.runAll() == 2);
+        REQUIRE(calls == std::vector<std::string>{"then 10", "finally"});
+    }
+    SECTION("When the Promise is rejected") {
+        QueueExecutor executor;
+        std::string result;
+        Promise<int>::Reject("FAIL").failed(executor, [&result](const std::string& reason) { result = reason; });
+        REQUIRE(result.empty());
+        executor.runAll();
+        REQUIRE(result == "FAIL");
+    }
+    SECTION("When the callback returns another Promise") {
+        QueueExecutor executor;
+        std::function<void(const int&)> resolver;
+        long result = 0;
+        Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+            .then(executor, [](const int& val) { return Promise<long>::Resolve(val * 2); })
+            .then([&result](const long& val) { result = val; });
+        resolver(10);
+        REQUIRE(result == 0);
+        executor.runAll();
+        REQUIRE(result == 20);
+    }
+    SECTION("When the continuations are moved to another thread with via") {
+        QueueExecutor executor;
+        std::thread::id callbackThread;
+        std::thread t;
+        auto prom = Promise<int>([&t](auto&& resolve, auto&& reject) { t = AsyncTask(resolve, 10, 0.01); })
+                        .via(executor)
+                        .then([&callbackThread](const int& val) { callbackThread = std::this_thread::get_id(); });
+        t.join();
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::ONGOING);
+        std::thread runner([&executor] { executor.runAll(); });
+        std::thread::id runnerThread = runner.get_id();
+        runner.join();
+        REQUIRE(callbackThread == runnerThread);
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+    }
+}
+
+TEST_CASE("Promise callbacks can be attached concurrently with the fulfillment") {
+    constexpr int numThreads = 8;
+    constexpr int numCallbacks = 1000;
+
+    std::function<void(const int&)> resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+
+    std::atomic<int> resolved = 0;
+    std::atomic<int> finished = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&prom, &resolved, &finished] {
+            for (int j = 0; j < numCallbacks; j++) {
+                prom.then([&resolved](const int& val) { resolved += val; });
+                Promise<int>(prom).finally([&finished]() { finished++; });
+            }
+        });
+    }
+    resolver(1);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(resolved == numThreads * numCallbacks);
+    REQUIRE(finished == numThreads * numCallbacks);
+}
+
+TEST_CASE("Promise ready handles can be copied concurrently") {
+    constexpr int numThreads = 8;
+    constexpr int numCopies = 1000;
+
+    const auto prom = Promise<std::string>::Resolve("Hello World");
+    std::atomic<int> resolved = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; i++) {
+        threads.emplace_back([&prom, &resolved] {
+            for (int j = 0; j < numCopies; j++) {
+                Promise<std::string> copy = prom;
+                prom.then([&resolved](const std::string& val) {
+                    if (val == "Hello World") {
+                        resolved++;
+                    }
+                });
+                copy.then([&resolved](const std::string& val) {
+                    if (val == "Hello World") {
+                        resolved++;
+                    }
+                });
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE(resolved == 2 * numThreads * numCopies);
+}
+
+TEST_CASE("Promise callbacks run without blocking the promise they belong to") {
+    SECTION("When a callback registers more callbacks on its own promise") {
+        std::vector<int> order;
+        std::function<void(const int&)> resolver;
+        auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        prom.then([&prom, &order](const int& val) {
+            order.push_back(1);
+            prom.then([&order](const int& val) { order.push_back(3); });
+        });
+        prom.then([&order](const int& val) { order.push_back(2); });
+        resolver(10);
+        REQUIRE(order == std::vector<int>{1, 3, 2});
+    }
+    SECTION("When a slow callback is running on another thread") {
+        std::atomic<bool> release = false;
+        std::atomic<bool> running = false;
+        std::function<void(const int&)> resolver;
+        auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        prom.then([&release, &running](const int& val) {
+            running = true;
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+        std::thread t([&resolver] { resolver(10); });
+        while (!running) {
+            std::this_thread::yield();
+        }
+
+        int result = 0;
+        prom.then([&result](const int& val) { result = val; });
+        REQUIRE(result == 10);
+
+        release = true;
+        t.join();
+    }
+}
+
+TEST_CASE("Promise::wait should wait for the promise to complete") {
+    SECTION("When the Promise is resolved synchronously") {
+        auto prom = Promise<int>::Resolve(10);
+        prom.wait();
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+    }
+    SECTION("When the Promise is resolved asynchronously") {
+        std::thread t;
+        auto prom = Promise<int>([&t](auto&& resolve, auto&& reject) { t = AsyncTask(resolve, 10, 0.05); });
+        prom.wait();
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+        t.join();
+    }
+    SECTION("When the Promise is rejected asynchronously") {
+        std::thread t;
+        auto prom = Promise<int>([&t](auto&& resolve, auto&& reject) { t = AsyncTask(reject, "FAIL", 0.05); });
+        REQUIRE(prom.waitUntil(std::chrono::system_clock::now() + std::chrono::seconds(10)) ==
+                Promise<int>::Status::REJECTED);
+        t.join();
+    }
+    SECTION("When the timeout expires before the Promise is fulfilled") {
+        std::thread t;
+        auto prom = Promise<int>([&t](auto&& resolve, auto&& reject) { t = AsyncTask(resolve, 10, 0.25); });
+        REQUIRE(prom.waitFor(std::chrono::milliseconds(10)) == Promise<int>::Status::ONGOING);
+        t.join();
+        REQUIRE(prom.waitFor(std::chrono::milliseconds(10)) == Promise<int>::Status::RESOLVED);
+    }
+    SECTION("When the Promise is resolved while the waiters are going to sleep") {
+        for (int i = 0; i < 1000; i++) {
+            std::function<void(const int&)> resolver;
+            auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+            std::thread waiter([&prom] { prom.wait(); });
+            resolver(i);
+            waiter.join();
+        }
+    }
+}
+
+TEST_CASE("Promise::All should join promises of different types") {
+    using UserQuota = Promise<std::tuple<std::string, int, std::monostate>>;
+
+    SECTION("When the promises are already fulfilled") {
+        std::tuple<std::string, int, std::monostate> result;
+        UserQuota::All(Promise<std::string>::Resolve("user"), Promise<int>::Resolve(10), Promise<void>::Resolve())
+            .then([&result](const auto& val) { result = val; });
+        REQUIRE(std::get<0>(result) == "user");
+        REQUIRE(std::get<1>(result) == 10);
+    }
+    SECTION("When the promises are fulfilled later in any order") {
+        Promise<std::string>::ResolveCallback resolveUser;
+        Promise<int>::ResolveCallback resolveQuota;
+        Promise<void>::ResolveCallback resolveDone;
+        auto user = Promise<std::string>([&resolveUser](auto&& resolve, auto&& reject) { resolveUser = resolve; });
+        auto quota = Promise<int>([&resolveQuota](auto&& resolve, auto&& reject) { resolveQuota = resolve; });
+        auto done = Promise<void>([&resolveDone](auto&& resolve, auto&& reject) { resolveDone = resolve; });
+
+        std::optional<UserQuota> prom;
+        {
+            // The state of the result and the one shared by the promises
+            AllocationCounter counter;
+            prom.emplace(UserQuota::All(user, quota, std::move(done)));
+            REQUIRE(counter.count() == 2);
+        }
+
+        resolveQuota(10);
+        resolveDone();
+        REQUIRE(prom->waitFor(std::chrono::seconds(0)) == UserQuota::Status::ONGOING);
+        resolveUser("user");
+        REQUIRE(prom->waitFor(std::chrono::seconds(0)) == UserQuota::Status::RESOLVED);
+        std::string result;
+        prom->then([&result](const auto& val) { result = std::get<0>(val) + std::to_string(std::get<1>(val)); });
+        REQUIRE(result == "user10");
+        // The promises still hold their own values
+        user.then([&result](const std::string& val) { result = val; });
+        REQUIRE(result == "user");
+    }
+    SECTION("When one of the promises is rejected") {
+        Promise<int>::ResolveCallback resolver;
+        Promise<int>::RejectCallback rejecter;
+        auto first = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        auto second = Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; });
+
+        std::string reason;
+        auto prom = Promise<std::tuple<int, int>>::All(first, second).failed([&reason](const std::string& val) {
+            reason = val;
+        });
+        // Rejected right away, without waiting for the rest
+        rejecter("FAIL");
+        REQUIRE(reason == "FAIL");
+        resolver(10);
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<std::tuple<int, int>>::Status::REJECTED);
+    }
+    SECTION("When the values can only be moved") {
+        std::function<void(std::unique_ptr<int>&&)> resolver;
+        auto first = Promise<std::unique_ptr<int>>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+
+        int result = 0;
+        Promise<std::tuple<std::unique_ptr<int>, std::unique_ptr<int>>>::All(
+            std::move(first), Promise<std::unique_ptr<int>>::Resolve(std::make_unique<int>(1)))
+            .then([&result](auto val) { result = *std::get<0>(val) + *std::get<1>(val); });
+        resolver(std::make_unique<int>(10));
+        REQUIRE(result == 11);
+    }
+    SECTION("When no promises are given") {
+        bool called = false;
+        Promise<std::tuple<>>::All().then([&called](const std::tuple<>&) { called = true; });
+        REQUIRE(called);
+    }
+    SECTION("When the promises are fulfilled from other threads") {
+        for (int i = 0; i < 100; i++) {
+            std::thread first;
+            std::thread second;
+            auto prom = Promise<std::tuple<int, int>>::All(
+                Promise<int>([&first, i](auto&& resolve, auto&& reject) { first = AsyncTask(resolve, i, 0); }),
+                Promise<int>([&second, i](auto&& resolve, auto&& reject) { second = AsyncTask(resolve, i, 0); }));
+            REQUIRE(prom.waitFor(std::chrono::seconds(5)) == Promise<std::tuple<int, int>>::Status::RESOLVED);
+            int sum = 0;
+            prom.then([&sum](const std::tuple<int, int>& val) { sum = std::get<0>(val) + std::get<1>(val); });
+            REQUIRE(sum == 2 * i);
+            first.join();
+            second.join();
+        }
+    }
+}
+
+TEST_CASE("Promise::All should join a range of promises") {
+    SECTION("When the promises are fulfilled later") {
+        constexpr int numPromises = 1000;
+        std::vector<Promise<int>::ResolveCallback> resolvers(numPromises);
+        std::vector<Promise<int>> promises;
+        for (int i = 0; i < numPromises; i++) {
+            promises.push_back(
+                Promise<int>([&resolvers, i](auto&& resolve, auto&& reject) { resolvers[i] = resolve; }));
+        }
+
+        std::optional<Promise<std::vector<int>>> prom;
+        {
+            // The state of the result, the one shared by the promises and the values, whatever the number of promises
+            AllocationCounter counter;
+            prom.emplace(Promise<std::vector<int>>::All(promises.begin(), promises.end()));
+            REQUIRE(counter.count() == 3);
+        }
+
+        for (int i = numPromises - 1; i >= 0; i--) {
+            REQUIRE(prom->waitFor(std::chrono::seconds(0)) == Promise<std::vector<int>>::Status::ONGOING);
+            resolvers[i](i);
+        }
+        std::vector<int> result;
+        prom->then([&result](const std::vector<int>& val) { result = val; });
+        REQUIRE(result.size() == numPromises);
+        bool ordered = true;
+        for (int i = 0; i < numPromises; i++) {
+            ordered = ordered && result[i] == i;
+        }
+        REQUIRE(ordered);
+    }
+    SECTION("When one of the promises is rejected") {
+        std::vector<Promise<bool>> promises;
+        promises.push_back(Promise<bool>::Resolve(true));
+        promises.push_back(Promise<bool>([](auto&& resolve, auto&& reject) {}));
+        promises.push_back(Promise<bool>::Reject("FAIL"));
+
+        std::string reason;
+        Promise<std::vector<bool>>::All(promises.begin(), promises.end()).failed([&reason](const std::string& val) {
+            reason = val;
+        });
+        REQUIRE(reason == "FAIL");
+    }
+    SECTION("When the promises are consumed") {
+        std::vector<Promise<std::unique_ptr<int>>> promises;
+        for (int i = 0; i < 3; i++) {
+            promises.push_back(Promise<std::unique_ptr<int>>::Resolve(std::make_unique<int>(i)));
+        }
+
+        int result = 0;
+        Promise<std::vector<std::unique_ptr<int>>>::All(std::make_move_iterator(promises.begin()),
+                                                        std::make_move_iterator(promises.end()))
+            .then([&result](const std::vector<std::unique_ptr<int>>& val) { result = *val[0] + *val[1] + *val[2]; });
+        REQUIRE(result == 3);
+    }
+    SECTION("When the range is empty") {
+        std::vector<Promise<int>> promises;
+        bool called = false;
+        Promise<std::vector<int>>::All(promises.begin(), promises.end()).then([&called](const std::vector<int>& val) {
+            called = val.empty();
+        });
+        REQUIRE(called);
+    }
+    SECTION("When the promises are fulfilled from other threads") {
+        constexpr int numPromises = 10000;
+        std::vector<Promise<int>::ResolveCallback> resolvers(numPromises);
+        std::vector<Promise<int>> promises;
+        for (int i = 0; i < numPromises; i++) {
+            promises.push_back(
+                Promise<int>([&resolvers, i](auto&& resolve, auto&& reject) { resolvers[i] = resolve; }));
+        }
+        auto prom = Promise<std::vector<int>>::All(promises.begin(), promises.end());
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&resolvers, i] {
+                for (int j = i; j < numPromises; j += 4) {
+                    resolvers[j](j);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(prom.waitFor(std::chrono::seconds(5)) == Promise<std::vector<int>>::Status::RESOLVED);
+        long long sum = 0;
+        prom.then([&sum](const std::vector<int>& val) {
+            for (int value : val) {
+                sum += value;
+            }
+        });
+        REQUIRE(sum == static_cast<long long>(numPromises) * (numPromises - 1) / 2);
+    }
+}
+
+TEST_CASE("Promise::Race should settle like the first promise to be fulfilled") {
+    SECTION("When a promise is resolved first") {
+        Promise<int>::ResolveCallback resolver;
+        Promise<int>::RejectCallback rejecter;
+        auto first = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        auto second = Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; });
+
+        int result = 0;
+        auto prom = Promise<int>::Race(first, second).then([&result](const int& val) { result = val; });
+        resolver(10);
+        REQUIRE(result == 10);
+        rejecter("FAIL");
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::Status::RESOLVED);
+    }
+    SECTION("When a promise is rejected first") {
+        std::vector<Promise<int>> promises;
+        promises.push_back(Promise<int>([](auto&& resolve, auto&& reject) {}));
+        promises.push_back(Promise<int>::Reject("FAIL"));
+        promises.push_back(Promise<int>::Resolve(10));
+
+        std::string reason;
+        Promise<int>::Race(promises.begin(), promises.end()).failed([&reason](const std::string& val) {
+            reason = val;
+        });
+        REQUIRE(reason == "FAIL");
+    }
+    SECTION("When the race is over the losers don't hold the result") {
+        Promise<int>::ResolveCallback loserResolver;
+        Promise<int>::ResolveCallback winnerResolver;
+        auto loser = Promise<int>([&loserResolver](auto&& resolve, auto&& reject) { loserResolver = resolve; });
+        auto winner = Promise<int>([&winnerResolver](auto&& resolve, auto&& reject) { winnerResolver = resolve; });
+
+        std::weak_ptr<int> resource;
+        {
+            auto owned = std::make_shared<int>(0);
+            resource = owned;
+            Promise<int>::Race(loser, winner).finally([owned]() {});
+        }
+        REQUIRE(!resource.expired());
+        winnerResolver(1);
+        // The result and its continuations are gone although the loser is still pending
+        REQUIRE(resource.expired());
+        loserResolver(2);
+    }
+}
+
+TEST_CASE("Promise::Any should resolve with the first value") {
+    SECTION("When one of the promises is resolved") {
+        Promise<int>::RejectCallback rejecter;
+        Promise<int>::ResolveCallback resolver;
+        auto first = Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; });
+        auto second = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+
+        int result = 0;
+        auto prom = Promise<int>::Any(first, second).then([&result](const int& val) { result = val; });
+        rejecter("FAIL");
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == Promise<int>::AnyPromise::Status::ONGOING);
+        resolver(10);
+        REQUIRE(result == 10);
+    }
+    SECTION("When every promise is rejected") {
+        Promise<int>::RejectCallback rejecter;
+        auto first = Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; });
+
+        std::vector<std::string> reasons;
+        Promise<int>::Any(first, Promise<int>::Reject("SECOND"))
+            .failed([&reasons](const std::vector<std::string>& val) { reasons = val; });
+        REQUIRE(reasons.empty());
+        rejecter("FIRST");
+        REQUIRE(reasons == std::vector<std::string>{"FIRST", "SECOND"});
+    }
+    SECTION("When no promises are given") {
+        bool rejected = false;
+        Promise<int>::Any().failed([&rejected](const std::vector<std::string>& val) { rejected = val.empty(); });
+        REQUIRE(rejected);
+    }
+}
+
+TEST_CASE("Promise::AllSettled should report the outcome of every promise") {
+    SECTION("When the promises are fulfilled later") {
+        Promise<int>::ResolveCallback resolver;
+        Promise<int>::RejectCallback rejecter;
+        auto first = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+        auto second = Promise<int>([&rejecter](auto&& resolve, auto&& reject) { rejecter = reject; });
+
+        std::vector<Promise<int>::Settlement> result;
+        auto prom = Promise<int>::AllSettled(first, second, Promise<int>::Resolve(3))
+                        .then([&result](const std::vector<Promise<int>::Settlement>& val) { result = val; });
+        rejecter("FAIL");
+        REQUIRE(result.empty());
+        resolver(1);
+        REQUIRE(result.size() == 3);
+        REQUIRE(result[0].status == Promise<int>::Status::RESOLVED);
+        REQUIRE(*result[0].value == 1);
+        REQUIRE(result[1].status == Promise<int>::Status::REJECTED);
+        REQUIRE(*result[1].error == "FAIL");
+        REQUIRE(!result[1].value);
+        REQUIRE(*result[2].value == 3);
+    }
+    SECTION("When the promises are fulfilled from other threads") {
+        constexpr int numPromises = 1000;
+        std::vector<Promise<void>::ResolveCallback> resolvers(numPromises);
+        std::vector<Promise<void>::RejectCallback> rejecters(numPromises);
+        std::vector<Promise<void>> promises;
+        for (int i = 0; i < numPromises; i++) {
+            promises.push_back(Promise<void>([&resolvers, &rejecters, i](auto&& resolve, auto&& reject) {
+                resolvers[i] = resolve;
+                rejecters[i] = reject;
+            }));
+        }
+        auto prom = Promise<void>::AllSettled(promises.begin(), promises.end());
+
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; i++) {
+            threads.emplace_back([&resolvers, &rejecters, i] {
+                for (int j = i; j < numPromises; j += 4) {
+                    if (j % 2 == 0) {
+                        resolvers[j]();
+                    } else {
+                        rejecters[j]("FAIL");
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(prom.waitFor(std::chrono::seconds(5)) == Promise<void>::AllSettledPromise::Status::RESOLVED);
+        int rejected = 0;
+        prom.then([&rejected](const std::vector<Promise<void>::Settlement>& val) {
+            for (const auto& settlement : val) {
+                rejected += settlement.status == Promise<void>::Status::REJECTED ? 1 : 0;
+            }
+        });
+        REQUIRE(rejected == numPromises / 2);
+    }
+}
@@ -0,0 +1,171 @@
+#if defined(__linux__)
+
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <sys/socket.h>
+    #include <unistd.h>
+
+    #include <array>
+    #include <atomic>
+    #include <chrono>
+    #include <memory>
+    #include <string>
+    #include <vector>
+
+    #include <catch2/catch.hpp>
+
+    #include <edoren/Reactor.hpp>
+    #include <edoren/ThreadPool.hpp>
+
+using namespace edoren;
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Pipe {
+    Pipe() {
+        ::pipe2(fds.data(), O_NONBLOCK | O_CLOEXEC);
+    }
+
+    ~Pipe() {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    int reader() const {
+        return fds[0];
+    }
+
+    int writer() const {
+        return fds[1];
+    }
+
+    std::array<int, 2> fds = {-1, -1};
+};
+
+}  // namespace
+
+TEST_CASE("Reactor should resolve the promises once the descriptor is ready") {
+    Reactor reactor;
+
+    SECTION("When reading from a pipe") {
+        Pipe pipe;
+        auto prom = reactor.readable(pipe.reader());
+        REQUIRE(prom.waitFor(50ms) == Promise<void>::Status::ONGOING);
+
+        REQUIRE(::write(pipe.writer(), "x", 1) == 1);
+        REQUIRE(prom.waitFor(5s) == Promise<void>::Status::RESOLVED);
+        char data = 0;
+        REQUIRE(::read(pipe.reader(), &data, 1) == 1);
+        REQUIRE(data == 'x');
+    }
+    SECTION("When writing to a pipe") {
+        Pipe pipe;
+        REQUIRE(reactor.writable(pipe.writer()).waitFor(5s) == Promise<void>::Status::RESOLVED);
+    }
+    SECTION("When the other end of a pipe is closed") {
+        Pipe pipe;
+        auto prom = reactor.readable(pipe.reader());
+        ::close(pipe.fds[1]);
+        pipe.fds[1] = -1;
+        REQUIRE(prom.waitFor(5s) == Promise<void>::Status::RESOLVED);
+        char data = 0;
+        REQUIRE(::read(pipe.reader(), &data, 1) == 0);
+    }
+    SECTION("When reading and writing on the same loopback socket") {
+        int listener = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&address), length) == 0);
+        REQUIRE(::listen(listener, 1) == 0);
+        REQUIRE(::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+
+        auto accepted = reactor.readable(listener);
+        int client = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        ::connect(client, reinterpret_cast<sockaddr*>(&address), length);
+        REQUIRE(reactor.writable(client).waitFor(5s) == Promise<void>::Status::RESOLVED);
+        REQUIRE(accepted.waitFor(5s) == Promise<void>::Status::RESOLVED);
+        int server = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        REQUIRE(server >= 0);
+
+        // Both directions wait on the same descriptor at once
+        auto request = reactor.readable(server);
+        auto response = reactor.writable(server);
+        REQUIRE(response.waitFor(5s) == Promise<void>::Status::RESOLVED);
+        REQUIRE(request.waitFor(50ms) == Promise<void>::Status::ONGOING);
+        REQUIRE(::send(client, "ping", 4, 0) == 4);
+        REQUIRE(request.waitFor(5s) == Promise<void>::Status::RESOLVED);
+
+        ::close(server);
+        ::close(client);
+        ::close(listener);
+    }
+    SECTION("When the descriptor can't be polled") {
+        std::string reason;
+        reactor.readable(-1).failed([&reason](const std::string& val) { reason = val; });
+        REQUIRE(!reason.empty());
+    }
+}
+
+TEST_CASE("Reactor should serve many descriptors from one thread") {
+    Reactor reactor;
+    std::vector<Pipe> pipes(200);
+    std::atomic<int> ready(0);
+    std::vector<Promise<void>> promises;
+    for (auto& pipe : pipes) {
+        promises.push_back(reactor.readable(pipe.reader()).then([&ready]() { ready++; }));
+    }
+    REQUIRE(ready == 0);
+    for (auto& pipe : pipes) {
+        REQUIRE(::write(pipe.writer(), "x", 1) == 1);
+    }
+    for (auto& prom : promises) {
+        prom.wait();
+    }
+    REQUIRE(ready == 200);
+}
+
+TEST_CASE("Reactor should resolve the promises on the given executor") {
+    ThreadPool pool(2);
+    Reactor reactor(pool);
+    Pipe pipe;
+
+    std::atomic<bool> inPool(false);
+    auto prom = reactor.readable(pipe.reader()).then([&pool, &inPool]() { inPool = pool.isWorkerThread(); });
+    REQUIRE(::write(pipe.writer(), "x", 1) == 1);
+    prom.wait();
+    REQUIRE(inPool);
+
+    std::atomic<bool> executed(false);
+    Promise<void>([&reactor, &executed](auto&& resolve, auto&& reject) {
+        reactor.execute([resolve, &executed] {
+            executed = true;
+            resolve();
+        });
+    }).wait();
+    REQUIRE(executed);
+}
+
+TEST_CASE("Reactor should reject the waits that can't complete anymore") {
+    Pipe pipe;
+    std::string reason;
+
+    SECTION("When the wait is cancelled") {
+        Reactor reactor;
+        auto prom = reactor.readable(pipe.reader()).failed([&reason](const std::string& val) { reason = val; });
+        reactor.cancel(pipe.reader());
+        REQUIRE(prom.waitFor(0s) == Promise<void>::Status::REJECTED);
+        REQUIRE(reason == "Reactor wait cancelled");
+    }
+    SECTION("When the reactor is destroyed") {
+        auto reactor = std::make_unique<Reactor>();
+        auto prom = reactor->readable(pipe.reader());
+        reactor.reset();
+        REQUIRE(prom.waitFor(0s) == Promise<void>::Status::REJECTED);
+    }
+}
+
+#endif
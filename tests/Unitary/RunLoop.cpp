@@ -0,0 +1,168 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/Promise.hpp>
+#include <edoren/RunLoop.hpp>
+
+using namespace edoren;
+
+template <typename Res>
+using LocalPromise = Promise<Res, std::string, SingleThreaded>;
+
+TEST_CASE("RunLoop should run the queued work only when asked to") {
+    RunLoop loop;
+    std::vector<int> calls;
+    loop.execute([&calls] { calls.push_back(1); });
+    loop.execute([&loop, &calls] {
+        calls.push_back(2);
+        loop.execute([&calls] { calls.push_back(4); });
+    });
+    loop.execute([&calls, value = std::make_unique<int>(3)] { calls.push_back(*value); });
+
+    REQUIRE(calls.empty());
+    REQUIRE(loop.size() == 3);
+    REQUIRE(loop.runOnce());
+    REQUIRE(calls == std::vector<int>{1});
+    REQUIRE(loop.run() == 3);
+    REQUIRE(calls == std::vector<int>{1, 2, 3, 4});
+    REQUIRE(loop.empty());
+    REQUIRE(!loop.runOnce());
+}
+
+TEST_CASE("SingleThreaded Promise should behave as the thread-safe one") {
+    SECTION("When the promise is already fulfilled") {
+        int result = 0;
+        std::string reason;
+        LocalPromise<int>::Resolve(10)
+            .then([](const int& val) { return LocalPromise<int>::Resolve(val * 2); })
+            .then([&result](const int& val) { result = val; });
+        LocalPromise<int>::Reject("FAIL").failed([&reason](const std::string& val) { reason = val; });
+        REQUIRE(result == 20);
+        REQUIRE(reason == "FAIL");
+    }
+    SECTION("When the promise is fulfilled later") {
+        LocalPromise<int>::ResolveCallback resolver;
+        std::vector<std::string> calls;
+        auto prom = LocalPromise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                        .then([&calls](const int& val) {
+                            calls.push_back("then " + std::to_string(val));
+                            return LocalPromise<long>::Resolve(val + 1);
+                        })
+                        .then([&calls](const long& val) { calls.push_back("then " + std::to_string(val)); })
+                        .finally([&calls]() { calls.push_back("finally"); });
+        REQUIRE(prom.waitFor(std::chrono::seconds(1)) == LocalPromise<long>::Status::ONGOING);
+        resolver(1);
+        REQUIRE(calls == std::vector<std::string>{"then 1", "then 2", "finally"});
+        REQUIRE(prom.waitFor(std::chrono::seconds(0)) == LocalPromise<long>::Status::RESOLVED);
+    }
+    SECTION("When a long chain of ongoing promises is fulfilled") {
+        LocalPromise<int>::ResolveCallback resolver;
+        std::vector<LocalPromise<int>> chain;
+        chain.push_back(LocalPromise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; }));
+        for (int i = 0; i < 100000; i++) {
+            chain.push_back(chain.back().then([](const int& val) { return LocalPromise<int>::Resolve(val + 1); }));
+        }
+        resolver(0);
+        int result = 0;
+        chain.back().then([&result](const int& val) { result = val; });
+        REQUIRE(result == 100000);
+    }
+}
+
+TEST_CASE("SingleThreaded Promise can be cancelled") {
+    SECTION("When every handle of a demand tracked promise is dropped") {
+        CancellationToken producer;
+        {
+            auto prom = LocalPromise<int>(
+                [&producer](auto&& resolve, auto&& reject, CancellationToken token) { producer = token; });
+            auto chained = prom.then([](const int& val) {});
+        }
+        REQUIRE(producer.isCancellationRequested());
+    }
+    SECTION("When the token of a chain is cancelled") {
+        CancellationSource source{SingleThreaded()};
+        LocalPromise<int>::ResolveCallback resolver;
+        int called = 0;
+        std::string reason;
+        auto prom = LocalPromise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                        .then(source.getToken(), [&called](const int& val) { called++; })
+                        .failed([&reason](const std::string& val) { reason = val; });
+        source.requestCancellation();
+        resolver(10);
+        REQUIRE(called == 0);
+        REQUIRE(reason == "Promise has been cancelled");
+    }
+}
+
+TEST_CASE("SingleThreaded Promise continuations can run on a RunLoop") {
+    RunLoop loop;
+    std::vector<std::string> calls;
+    LocalPromise<int>::Resolve(10)
+        .via(loop)
+        .then([&calls](const int& val) {
+            calls.push_back("then " + std::to_string(val));
+            return LocalPromise<std::string>::Resolve("done");
+        })
+        .then(loop, [&calls](const std::string& val) { calls.push_back(val); });
+
+    REQUIRE(calls.empty());
+    REQUIRE(loop.runOnce());
+    REQUIRE(calls == std::vector<std::string>{"then 10"});
+    REQUIRE(loop.run() == 1);
+    REQUIRE(calls == std::vector<std::string>{"then 10", "done"});
+}
+
+TEST_CASE("Promise::wait can run a RunLoop until the promise is fulfilled") {
+    RunLoop loop;
+    std::vector<int> calls;
+    auto prom = LocalPromise<int>::Resolve(1)
+                    .via(loop)
+                    .then([&calls](const int& val) {
+                        calls.push_back(val);
+                        return LocalPromise<int>::Resolve(val + 1);
+                    })
+                    .then(loop, [&calls](const int& val) { calls.push_back(val); });
+    loop.execute([&calls] { calls.push_back(0); });
+
+    prom.wait(loop);
+    REQUIRE(calls == std::vector<int>{1, 0, 2});
+    REQUIRE(prom.waitFor(std::chrono::seconds(0)) == LocalPromise<int>::Status::RESOLVED);
+    REQUIRE(loop.empty());
+}
+
+TEST_CASE("Promise continuations queued on a RunLoop still see the value") {
+    RunLoop loop;
+    std::vector<std::string> calls;
+    LocalPromise<std::string>::ResolveCallback resolver;
+    auto readOnLoop = [&calls](const std::string& val) { calls.push_back("loop " + val); };
+    auto takeInline = [&calls](std::string val) {
+        calls.push_back("inline " + val);
+        return LocalPromise<int>::Resolve(0);
+    };
+
+    SECTION("When the handle is dropped before the promise is fulfilled") {
+        {
+            auto prom = LocalPromise<std::string>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+            prom.then(loop, readOnLoop);
+            prom.then([](std::string) {});
+        }
+        resolver(std::string(50, 'a'));
+        REQUIRE(calls.empty());
+    }
+    SECTION("When the handle is dropped after the promise is fulfilled") {
+        {
+            auto prom = LocalPromise<std::string>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+            prom.then(loop, readOnLoop);
+            resolver(std::string(50, 'a'));
+            std::move(prom).then(takeInline);
+        }
+        REQUIRE(calls == std::vector<std::string>{"inline " + std::string(50, 'a')});
+        calls.clear();
+    }
+
+    REQUIRE(loop.run() == 1);
+    REQUIRE(calls == std::vector<std::string>{"loop " + std::string(50, 'a')});
+}
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/Promise.hpp>
+#include <edoren/Strand.hpp>
+#include <edoren/ThreadPool.hpp>
+
+using namespace edoren;
+
+TEST_CASE("MpscQueue should keep the order of each producer") {
+    constexpr int numItems = 100000;
+    constexpr int numProducers = 4;
+    detail::MpscQueue<int> queue;
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < numProducers; i++) {
+        producers.emplace_back([&queue, i] {
+            for (int j = 0; j < numItems; j++) {
+                queue.push(i * numItems + j);
+            }
+        });
+    }
+
+    std::vector<int> last(numProducers, -1);
+    bool ordered = true;
+    int popped = 0;
+    while (popped < numItems * numProducers) {
+        int value = 0;
+        if (queue.pop(value)) {
+            ordered = ordered && value % numItems > last[value / numItems];
+            last[value / numItems] = value % numItems;
+            popped++;
+        }
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    REQUIRE(ordered);
+    int value = 0;
+    REQUIRE(!queue.pop(value));
+}
+
+TEST_CASE("Strand should never run two tasks at the same time") {
+    constexpr int numTasks = 20000;
+    constexpr int numProducers = 4;
+    ThreadPool pool(4);
+    Strand strand(pool);
+    // Only touched from the strand
+    int counter = 0;
+    std::atomic<bool> running(false);
+    std::atomic<int> overlaps(0);
+    std::atomic<int> done(0);
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < numProducers; i++) {
+        producers.emplace_back([&] {
+            for (int j = 0; j < numTasks; j++) {
+                strand.execute([&] {
+                    overlaps += running.exchange(true) ? 1 : 0;
+                    counter++;
+                    running = false;
+                    done++;
+                });
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    while (done < numTasks * numProducers) {
+        std::this_thread::yield();
+    }
+    REQUIRE(overlaps == 0);
+    REQUIRE(counter == numTasks * numProducers);
+}
+
+TEST_CASE("Strand should run the tasks in the order they were posted") {
+    ThreadPool pool(2);
+    Strand strand(pool);
+    std::vector<int> values;
+    std::atomic<bool> outside(false);
+    std::atomic<bool> inside(true);
+    for (int i = 0; i < 1000; i++) {
+        strand.execute([&values, i] { values.push_back(i); });
+    }
+    outside = strand.runningInThisThread();
+    auto prom = Promise<void>::Resolve().then(strand, [&strand, &inside]() {
+        inside = strand.runningInThisThread();
+    });
+    prom.wait();
+
+    REQUIRE(values.size() == 1000);
+    bool ordered = true;
+    for (int i = 0; i < 1000; i++) {
+        ordered = ordered && values[i] == i;
+    }
+    REQUIRE(ordered);
+    REQUIRE(!outside);
+    REQUIRE(inside);
+}
+
+TEST_CASE("Promise continuations on a strand should not need locking") {
+    constexpr int numPromises = 1000;
+    ThreadPool pool(4);
+    Strand strand(pool);
+    std::vector<int> results;
+
+    std::vector<Promise<int>::ResolveCallback> resolvers(numPromises);
+    std::vector<Promise<int>> promises;
+    for (int i = 0; i < numPromises; i++) {
+        promises.push_back(Promise<int>([&resolvers, i](auto&& resolve, auto&& reject) { resolvers[i] = resolve; })
+                               .then(strand, [&results](const int& val) { results.push_back(val); }));
+    }
+    // Fulfilled from several threads at once
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+        threads.emplace_back([&resolvers, i] {
+            for (int j = i; j < numPromises; j += 4) {
+                resolvers[j](j);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (auto& prom : promises) {
+        prom.wait();
+    }
+    REQUIRE(results.size() == numPromises);
+}
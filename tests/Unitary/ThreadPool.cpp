@@ -0,0 +1,302 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/Promise.hpp>
+#include <edoren/ThreadPool.hpp>
+
+#include "AllocationCounter.hpp"
+
+using namespace edoren;
+
+TEST_CASE("WorkStealingDeque should hand out every item exactly once") {
+    SECTION("When used only by the owner") {
+        detail::WorkStealingDeque<int*> deque(4);
+        std::vector<int> values(10);
+        for (auto& value : values) {
+            deque.push(&value);
+        }
+        // The owner takes the newest items first, the thieves the oldest
+        REQUIRE(deque.steal() == &values[0]);
+        for (int i = 9; i > 0; i--) {
+            REQUIRE(deque.pop() == &values[i]);
+        }
+        REQUIRE(deque.pop() == nullptr);
+        REQUIRE(deque.steal() == nullptr);
+        REQUIRE(deque.empty());
+    }
+    SECTION("When thieves steal while the owner pushes and pops") {
+        constexpr int numItems = 100000;
+        constexpr int numThieves = 3;
+        detail::WorkStealingDeque<int*> deque(8);
+        std::vector<int> values(numItems);
+        std::vector<std::atomic<int>> taken(numItems);
+        std::atomic<bool> done(false);
+
+        auto take = [&values, &taken](int* item) {
+            if (item != nullptr) {
+                taken[item - values.data()]++;
+            }
+        };
+
+        std::vector<std::thread> thieves;
+        for (int i = 0; i < numThieves; i++) {
+            thieves.emplace_back([&deque, &done, &take] {
+                while (!done.load()) {
+                    take(deque.steal());
+                }
+            });
+        }
+        for (int i = 0; i < numItems; i++) {
+            deque.push(&values[i]);
+            if (i % 3 == 0) {
+                take(deque.pop());
+            }
+        }
+        while (!deque.empty()) {
+            take(deque.pop());
+        }
+        done = true;
+        for (auto& thief : thieves) {
+            thief.join();
+        }
+
+        bool allTakenOnce = true;
+        for (auto& count : taken) {
+            allTakenOnce = allTakenOnce && count == 1;
+        }
+        REQUIRE(allTakenOnce);
+    }
+}
+
+TEST_CASE("ThreadPool should run all the submitted work") {
+    SECTION("When the work is submitted from outside the pool") {
+        std::atomic<int> count(0);
+        {
+            ThreadPool pool(4);
+            REQUIRE(pool.size() == 4);
+            REQUIRE(!pool.isWorkerThread());
+            for (int i = 0; i < 10000; i++) {
+                pool.execute([&count] { count++; });
+            }
+        }
+        REQUIRE(count == 10000);
+    }
+    SECTION("When the work is submitted from the workers") {
+        std::atomic<int> count(0);
+        std::atomic<int> inWorker(0);
+        {
+            ThreadPool pool(4);
+            for (int i = 0; i < 100; i++) {
+                pool.execute([&pool, &count, &inWorker] {
+                    for (int j = 0; j < 100; j++) {
+                        pool.execute([&pool, &count, &inWorker] {
+                            inWorker += pool.isWorkerThread() ? 1 : 0;
+                            count++;
+                        });
+                    }
+                });
+            }
+        }
+        REQUIRE(count == 10000);
+        REQUIRE(inWorker == 10000);
+    }
+    SECTION("When the tasks are move-only") {
+        std::atomic<int> sum(0);
+        {
+            ThreadPool pool(2);
+            for (int i = 0; i < 100; i++) {
+                pool.execute([&sum, value = std::make_unique<int>(i)] { sum += *value; });
+            }
+        }
+        REQUIRE(sum == 4950);
+    }
+}
+
+TEST_CASE("ThreadPool should spread the work between the workers") {
+    ThreadPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    std::atomic<int> arrived(0);
+
+    // Every task blocks until all of them started, so they have to run in different workers
+    for (int i = 0; i < 4; i++) {
+        pool.execute([&] {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                threads.insert(std::this_thread::get_id());
+            }
+            arrived++;
+            while (arrived < 4) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (arrived < 4) {
+        std::this_thread::yield();
+    }
+
+    REQUIRE(threads.size() == 4);
+}
+
+TEST_CASE("ThreadPool should not allocate for the work submitted from a worker once warmed up") {
+    constexpr int numTasks = 100;
+
+    ThreadPool pool(1);
+    std::atomic<int> finished = 0;
+    auto submit = [&pool, &finished] {
+        for (int i = 0; i < numTasks; i++) {
+            pool.execute([&finished] { finished++; });
+        }
+    };
+    pool.execute(submit);
+    while (finished != numTasks) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<std::size_t> allocations = 1;
+    pool.execute([&submit, &allocations] {
+        AllocationCounter counter;
+        submit();
+        allocations = counter.count();
+    });
+    while (finished != 2 * numTasks) {
+        std::this_thread::yield();
+    }
+    REQUIRE(allocations == 0);
+}
+
+TEST_CASE("ThreadPool should run the promise continuations") {
+    ThreadPool pool(4);
+
+    SECTION("When the promise is fulfilled in a worker") {
+        std::atomic<int> inWorker(0);
+        auto prom = Promise<int>([&pool](auto&& resolve, auto&& reject) {
+                        pool.execute([resolve] { resolve(1); });
+                    }).then(pool, [&pool, &inWorker](const int& value) {
+                          inWorker += pool.isWorkerThread() ? 1 : 0;
+                          return Promise<int>::Resolve(value + 1);
+                      })
+                        .then(pool, [&pool, &inWorker](const int& value) {
+                            inWorker += pool.isWorkerThread() ? 1 : 0;
+                            return Promise<int>::Resolve(value * 10);
+                        });
+
+        prom.wait();
+        int result = 0;
+        prom.then([&result](const int& value) { result = value; });
+        REQUIRE(result == 20);
+        REQUIRE(inWorker == 2);
+    }
+    SECTION("When many chains run at the same time") {
+        std::vector<Promise<int>> promises;
+        for (int i = 0; i < 1000; i++) {
+            promises.push_back(Promise<int>::Resolve(i)
+                                   .then(pool, [](const int& value) { return Promise<int>::Resolve(value + 1); })
+                                   .then(pool, [](const int& value) { return Promise<int>::Resolve(value * 2); }));
+        }
+
+        int sum = 0;
+        for (auto& prom : promises) {
+            prom.wait();
+            prom.then([&sum](const int& value) { sum += value; });
+        }
+        REQUIRE(sum == 1001000);
+    }
+}
+
+TEST_CASE("Promise::wait should run the pending work of the pool instead of blocking") {
+    SECTION("When a worker waits on work queued in its own pool") {
+        ThreadPool pool(1);
+        std::atomic<int> seen(0);
+        auto prom = Promise<void>::Resolve().then(pool, [&pool, &seen]() {
+            // The only worker is running this task, the continuation can only run if the wait helps
+            std::atomic<int> inner(0);
+            Promise<void>::Resolve().then(pool, [&inner]() { inner = 10; }).wait();
+            seen = inner.load();
+        });
+        REQUIRE(prom.waitFor(std::chrono::seconds(5)) == Promise<void>::Status::RESOLVED);
+        REQUIRE(seen == 10);
+    }
+    SECTION("When the tasks wait on the tasks they spawn") {
+        ThreadPool pool(2);
+        std::atomic<int> count(0);
+        std::function<void(int)> work = [&pool, &count, &work](int depth) {
+            count++;
+            if (depth == 0) {
+                return;
+            }
+            auto left = Promise<void>::Resolve().then(pool, [&work, depth]() { work(depth - 1); });
+            auto right = Promise<void>::Resolve().then(pool, [&work, depth]() { work(depth - 1); });
+            left.wait();
+            right.wait();
+        };
+        auto prom = Promise<void>::Resolve().then(pool, [&work]() { work(8); });
+        REQUIRE(prom.waitFor(std::chrono::seconds(10)) == Promise<void>::Status::RESOLVED);
+        REQUIRE(count == 511);
+    }
+}
+
+// Executor drained by the waiting thread, it counts the attempts to catch a helper spinning
+class CountingQueue {
+public:
+    template <typename Func>
+    void execute(Func&& func) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_tasks.emplace_back(std::forward<Func>(func));
+        }
+        m_parking.notify();
+    }
+
+    bool runOnce() {
+        attempts++;
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_tasks.empty()) {
+                return false;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.erase(m_tasks.begin());
+        }
+        task();
+        return true;
+    }
+
+    detail::HelperParking& getHelperParking() {
+        return m_parking;
+    }
+
+    std::atomic<int> attempts{0};
+
+private:
+    std::mutex m_mutex;
+    std::vector<std::function<void()>> m_tasks;
+    detail::HelperParking m_parking;
+};
+
+TEST_CASE("Promise::wait should park the helping thread until there is work to run") {
+    CountingQueue queue;
+    Promise<int>::ResolveCallback resolver;
+    auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; });
+    std::atomic<bool> ran(false);
+    std::thread producer([&queue, &resolver, &ran] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.execute([&ran] { ran = true; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        resolver(10);
+    });
+    prom.wait(queue);
+    producer.join();
+
+    REQUIRE(ran);
+    REQUIRE(queue.attempts < 20);
+}
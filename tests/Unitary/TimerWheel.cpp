@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/Promise.hpp>
+#include <edoren/TimerWheel.hpp>
+
+using namespace edoren;
+using namespace std::chrono_literals;
+
+namespace {
+
+// Polls `condition` for up to a few seconds, timers are not expected to be precise on a loaded machine
+template <typename Condition>
+bool eventually(Condition&& condition) {
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(1ms);
+    }
+    return true;
+}
+
+}  // namespace
+
+TEST_CASE("TimerWheel should fire the timers in deadline order") {
+    TimerWheel wheel;
+    std::mutex mutex;
+    std::vector<int> fired;
+    auto record = [&mutex, &fired](int value) {
+        return [&mutex, &fired, value] {
+            std::lock_guard<std::mutex> lock(mutex);
+            fired.push_back(value);
+        };
+    };
+
+    auto now = TimerWheel::Clock::now();
+    // Spread across the first two levels of the wheel
+    wheel.armAt(now + 150ms, record(3));
+    wheel.armAt(now + 5ms, record(1));
+    wheel.armAt(now + 70ms, record(2));
+    REQUIRE(wheel.size() == 3);
+
+    REQUIRE(eventually([&] { return wheel.size() == 0; }));
+    std::lock_guard<std::mutex> lock(mutex);
+    REQUIRE(fired == std::vector<int>{1, 2, 3});
+}
+
+TEST_CASE("TimerWheel should never fire a timer before its deadline") {
+    TimerWheel wheel;
+    std::atomic<int> early(0);
+    std::atomic<int> fired(0);
+    for (int i = 0; i < 200; i++) {
+        auto deadline = TimerWheel::Clock::now() + std::chrono::milliseconds(i % 100);
+        wheel.armAt(deadline, [deadline, &early, &fired] {
+            early += TimerWheel::Clock::now() < deadline ? 1 : 0;
+            fired++;
+        });
+    }
+    REQUIRE(eventually([&] { return fired == 200; }));
+    REQUIRE(early == 0);
+}
+
+TEST_CASE("TimerWheel should not fire cancelled timers") {
+    TimerWheel wheel;
+    std::atomic<int> fired(0);
+
+    std::vector<TimerWheel::TimerId> ids;
+    for (int i = 0; i < 100000; i++) {
+        ids.push_back(wheel.arm(std::chrono::milliseconds(1000 + i % 500), [&fired] { fired++; }));
+    }
+    // Far enough to be parked in the upper levels
+    auto far = wheel.arm(std::chrono::hours(24 * 365 * 10), [&fired] { fired++; });
+    REQUIRE(wheel.size() == 100001);
+
+    bool allCancelled = true;
+    for (std::size_t i = 0; i < ids.size(); i += 2) {
+        allCancelled = wheel.cancel(ids[i]) && allCancelled;
+    }
+    REQUIRE(allCancelled);
+    REQUIRE(wheel.cancel(far));
+    REQUIRE(!wheel.cancel(far));
+    REQUIRE(wheel.size() == 50000);
+
+    REQUIRE(eventually([&] { return fired == 50000; }));
+    REQUIRE(wheel.size() == 0);
+    // The timers already fired can't be cancelled anymore
+    REQUIRE(!wheel.cancel(ids[1]));
+}
+
+TEST_CASE("Promise<void>::Delay should resolve after the given duration") {
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<bool> called(false);
+    auto prom = Promise<void>::Delay(20ms).then([&called]() { called = true; });
+
+    REQUIRE(prom.waitFor(5s) == Promise<void>::Status::RESOLVED);
+    REQUIRE(called);
+    REQUIRE(std::chrono::steady_clock::now() - start >= 20ms);
+}
+
+TEST_CASE("Promise::timeout should reject the promises that take too long") {
+    // A wheel of its own, the default one is shared with the rest of the process
+    TimerWheel wheel;
+
+    SECTION("When the promise is fulfilled in time") {
+        Promise<int>::ResolveCallback resolver;
+        auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                        .timeout(wheel, 10s, "TIMEOUT");
+        REQUIRE(wheel.size() == 1);
+        resolver(10);
+
+        int result = 0;
+        REQUIRE(prom.waitFor(0s) == Promise<int>::Status::RESOLVED);
+        prom.then([&result](const int& val) { result = val; });
+        REQUIRE(result == 10);
+        REQUIRE(wheel.size() == 0);
+    }
+    SECTION("When the promise takes too long") {
+        Promise<int>::ResolveCallback resolver;
+        auto prom = Promise<int>([&resolver](auto&& resolve, auto&& reject) { resolver = resolve; })
+                        .timeout(wheel, 10ms, "TIMEOUT");
+
+        std::string reason;
+        REQUIRE(prom.waitFor(5s) == Promise<int>::Status::REJECTED);
+        prom.failed([&reason](const std::string& val) { reason = val; });
+        REQUIRE(reason == "TIMEOUT");
+
+        // Fulfilling it later has no effect
+        resolver(10);
+        REQUIRE(prom.waitFor(0s) == Promise<int>::Status::REJECTED);
+    }
+    SECTION("When the promise is already fulfilled") {
+        int result = 0;
+        Promise<int>::Resolve(10).timeout(wheel, 0ms, "TIMEOUT").then([&result](const int& val) { result = val; });
+        REQUIRE(result == 10);
+    }
+}
@@ -0,0 +1,86 @@
+#include <array>
+#include <memory>
+#include <string>
+
+#include <catch2/catch.hpp>
+
+#include <edoren/UniqueFunction.hpp>
+
+using namespace edoren;
+
+namespace {
+
+struct InstanceCounter {
+    explicit InstanceCounter(int& instances) : instances(&instances) {
+        (*this->instances)++;
+    }
+
+    InstanceCounter(const InstanceCounter& other) : instances(other.instances) {
+        (*instances)++;
+    }
+
+    ~InstanceCounter() {
+        (*instances)--;
+    }
+
+    int* instances;
+};
+
+}  // namespace
+
+TEST_CASE("UniqueFunction should invoke the stored callable") {
+    SECTION("When the callable is stored inline") {
+        UniqueFunction<int(int, int)> func = [](int a, int b) { return a + b; };
+        REQUIRE(func);
+        REQUIRE(func(1, 2) == 3);
+    }
+    SECTION("When the callable is stored on the heap") {
+        std::array<int, 32> values = {};
+        values[31] = 10;
+        UniqueFunction<int(int)> func = [values](int index) { return values[index]; };
+        REQUIRE(func(31) == 10);
+    }
+    SECTION("When the callable captures move-only types") {
+        auto value = std::make_unique<std::string>("Hello World");
+        UniqueFunction<std::string()> func = [value = std::move(value)]() { return *value; };
+        REQUIRE(func() == "Hello World");
+    }
+    SECTION("When the callable is mutable") {
+        UniqueFunction<int()> func = [count = 0]() mutable { return ++count; };
+        func();
+        REQUIRE(func() == 2);
+    }
+    SECTION("When the arguments are forwarded") {
+        UniqueFunction<std::unique_ptr<int>(std::unique_ptr<int>&&)> func = [](std::unique_ptr<int>&& value) {
+            return std::move(value);
+        };
+        REQUIRE(*func(std::make_unique<int>(10)) == 10);
+    }
+}
+
+TEST_CASE("UniqueFunction should release the stored callable") {
+    SECTION("When the callable is stored inline") {
+        int instances = 0;
+        {
+            UniqueFunction<void()> func = [counter = InstanceCounter(instances)]() {};
+            UniqueFunction<void()> other = std::move(func);
+            REQUIRE_FALSE(func);
+            REQUIRE(other);
+            REQUIRE(instances == 1);
+        }
+        REQUIRE(instances == 0);
+    }
+    SECTION("When the callable is stored on the heap") {
+        int instances = 0;
+        {
+            std::array<char, 128> padding = {};
+            UniqueFunction<void()> func = [counter = InstanceCounter(instances), padding]() {};
+            UniqueFunction<void()> other;
+            other = std::move(func);
+            REQUIRE(instances == 1);
+            other = nullptr;
+            REQUIRE(instances == 0);
+        }
+        REQUIRE(instances == 0);
+    }
+}